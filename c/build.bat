@@ -101,9 +101,25 @@ if errorlevel 1 (
     exit /b 1
 )
 
+REM Compile tunnel engine (libtunnelmgr)
+echo Compiling tunnel engine...
+gcc -Wall -Wextra -std=c99 -pthread -O2 -DWINDOWS -Icjson -I. -c tunnelmgr.c -o tunnelmgr.o
+if errorlevel 1 (
+    echo Error compiling tunnelmgr.c
+    exit /b 1
+)
+
+REM Compile web dashboard
+echo Compiling dashboard...
+gcc -Wall -Wextra -std=c99 -pthread -O2 -DWINDOWS -Icjson -I. -c dashboard.c -o dashboard.o
+if errorlevel 1 (
+    echo Error compiling dashboard.c
+    exit /b 1
+)
+
 REM Compile main program
 echo Compiling tunnel manager...
-gcc -Wall -Wextra -std=c99 -pthread -O2 -DWINDOWS -Icjson -c main.c -o main.o
+gcc -Wall -Wextra -std=c99 -pthread -O2 -DWINDOWS -Icjson -I. -c main.c -o main.o
 if errorlevel 1 (
     echo Error compiling main.c
     exit /b 1
@@ -111,7 +127,7 @@ if errorlevel 1 (
 
 REM Link executable
 echo Linking tunnel_manager.exe...
-gcc main.o cjson/cJSON.o -o tunnel_manager.exe -pthread -lws2_32
+gcc main.o dashboard.o tunnelmgr.o cjson/cJSON.o -o tunnel_manager.exe -pthread -lws2_32
 if errorlevel 1 (
     echo Error linking executable
     exit /b 1
@@ -149,6 +165,7 @@ goto end
 :clean
 echo Cleaning build files...
 if exist main.o del main.o
+if exist dashboard.o del dashboard.o
 if exist test.o del test.o
 if exist cjson\cJSON.o del cjson\cJSON.o
 if exist tunnel_manager.exe del tunnel_manager.exe
@@ -0,0 +1,77 @@
+#ifndef COMPAT_H
+#define COMPAT_H
+
+// Linux calls the engine, the CLI and the dashboard use, emulated on Darwin.
+// The fallbacks set close-on-exec and non-blocking with fcntl() after the
+// call: not atomic, an ssh forked on another thread in that instant may
+// inherit the fd until it execs.
+
+#ifdef __APPLE__
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Older SDKs: sockets get SO_NOSIGPIPE instead
+#endif
+
+// Not socket type bits on Darwin, compat_socket() strips them
+#ifndef SOCK_CLOEXEC
+#define SOCK_NONBLOCK 0x20000000
+#define SOCK_CLOEXEC 0x10000000
+#define COMPAT_SOCKET_FLAGS
+#endif
+
+static inline int compat_fd_flags(int fd, int flags)
+{
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    if (((flags & SOCK_CLOEXEC) && fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) ||
+        ((flags & SOCK_NONBLOCK) && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#ifdef COMPAT_SOCKET_FLAGS
+static inline int compat_socket(int domain, int type, int protocol)
+{
+    return compat_fd_flags(socket(domain, type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC), protocol), type);
+}
+#define socket(domain, type, protocol) compat_socket(domain, type, protocol)
+#endif
+
+static inline int accept4(int fd, struct sockaddr *addr, socklen_t *len, int flags)
+{
+    return compat_fd_flags(accept(fd, addr, len), flags);
+}
+
+static inline int pipe2(int fds[2], int flags)
+{
+    if (pipe(fds) != 0)
+        return -1;
+    for (int i = 0; i < 2; i++)
+    {
+        if (((flags & O_CLOEXEC) && fcntl(fds[i], F_SETFD, FD_CLOEXEC) != 0) ||
+            ((flags & O_NONBLOCK) && fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK) != 0))
+        {
+            close(fds[0]);
+            close(fds[1]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Darwin only names the calling thread; every caller here passes pthread_self()
+#define pthread_setname_np(thread, name) pthread_setname_np(name)
+
+#endif // __APPLE__
+
+#endif // COMPAT_H
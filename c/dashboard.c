@@ -0,0 +1,599 @@
+#define _GNU_SOURCE // accept4, pipe2, open_memstream
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include "cjson/cJSON.h"
+#include "colors.h"
+#include "compat.h"
+#include "dashboard.h"
+
+#ifdef _WIN32
+
+int dashboard_start(tm_manager_t *tm, const char *listen_spec)
+{
+    (void)tm;
+    fprintf(stderr, "%s❌ The web dashboard is not available on Windows (%s)%s\n", C_ERROR, listen_spec, C_RESET);
+    return -1;
+}
+
+void dashboard_event(const tm_event_t *event)
+{
+    (void)event;
+}
+
+void dashboard_stop(void)
+{
+}
+
+#else
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DASH_MAX_CLIENTS 256
+#define DASH_REQUEST_MAX 2048
+#define DASH_CLIENT_BUFFER (512 * 1024) // Pending bytes before a slow client is dropped
+#define DASH_REFRESH_MS 2000            // Values without events (probe RTT, ...) are diffed this often
+#define DASH_PING_SECS 15               // SSE comment so proxies and dead peers notice
+#define DASH_LOG_QUEUE 64               // Warnings/errors queued between two broadcasts
+
+typedef struct
+{
+    int fd;
+    int sse;         // Subscribed to /events
+    int close_after; // Plain response: close once flushed
+    int dead;        // Fell too far behind, dropped by the server loop
+    char request[DASH_REQUEST_MAX];
+    size_t request_len;
+    char *out; // Pending output
+    size_t out_len;
+    size_t out_cap;
+} dash_client_t;
+
+typedef struct
+{
+    char tunnel[MAX_NAME_LEN];
+    time_t when;
+    tm_log_level_t level;
+    char message[256];
+} dash_log_t;
+
+static struct
+{
+    tm_manager_t *tm;
+    int listen_fd;
+    int wake[2]; // Event callback -> server thread
+    pthread_t thread;
+    volatile int running;
+
+    // Filled by dashboard_event() on engine threads
+    pthread_mutex_t lock;
+    char dirty[MAX_TUNNELS][MAX_NAME_LEN];
+    int dirty_count;
+    dash_log_t logs[DASH_LOG_QUEUE];
+    int log_count;
+
+    // Server thread only
+    dash_client_t clients[DASH_MAX_CLIENTS];
+    int client_count;
+    int subscribers;
+    char sent_name[MAX_TUNNELS][MAX_NAME_LEN]; // Last row broadcast per tunnel
+    char *sent_row[MAX_TUNNELS];
+    int sent_count;
+} dash = {.listen_fd = -1, .wake = {-1, -1}, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char dashboard_html[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>Chief Tunnel Officer</title>\n"
+    "<style>\n"
+    "body{font-family:system-ui,sans-serif;margin:1.5em;background:#111;color:#ddd}\n"
+    "h1{font-size:1.3em}#bar{margin:.8em 0;display:flex;gap:.8em;align-items:center}\n"
+    "input,select{background:#222;color:#ddd;border:1px solid #444;padding:.3em}\n"
+    "table{border-collapse:collapse;width:100%}th,td{padding:.25em .6em;text-align:left;border-bottom:1px solid #2a2a2a}\n"
+    "th{cursor:pointer;user-select:none;color:#9cf}tr:hover{background:#1b1b1b}\n"
+    ".RUNNING{color:#5d5}.STARTING,.RECONNECTING{color:#fd5}.ERROR,.AUTH-ERROR,.PORT-ERROR{color:#f66}.STOPPED{color:#888}\n"
+    ".warn{color:#fd5}.dim{color:#777}#logs{font-family:monospace;font-size:.85em;margin-top:1.2em}\n"
+    "</style></head><body>\n"
+    "<h1>&#x1F687; Chief Tunnel Officer</h1>\n"
+    "<div id=\"bar\"><input id=\"filter\" placeholder=\"Filter name, host, tag...\" size=\"30\">\n"
+    "<select id=\"state\"><option value=\"\">all states</option><option>RUNNING</option><option>STARTING</option>"
+    "<option>RECONNECTING</option><option>ERROR</option><option>AUTH-ERROR</option><option>PORT-ERROR</option>"
+    "<option>STOPPED</option><option value=\"!RUNNING\">not running</option></select>\n"
+    "<span id=\"summary\" class=\"dim\"></span><span id=\"conn\" class=\"dim\"></span></div>\n"
+    "<table><thead><tr><th data-k=\"name\">Name</th><th data-k=\"status\">Status</th><th data-k=\"type\">Type</th>"
+    "<th data-k=\"host\">Host</th><th data-k=\"local_port\">Local</th><th data-k=\"remote\">Remote</th>"
+    "<th data-k=\"priority\">Class</th><th data-k=\"restarts\">Restarts</th><th data-k=\"probe_rtt_ms\">Probe</th>"
+    "<th data-k=\"notes\">Notes</th></tr></thead><tbody id=\"rows\"></tbody></table>\n"
+    "<div id=\"logs\"></div>\n"
+    "<script>\n"
+    "const rows=new Map();let key='name',dir=1,queued=false;\n"
+    "const $=id=>document.getElementById(id);\n"
+    "const esc=s=>String(s).replace(/[&<>\"']/g,c=>'&#'+c.charCodeAt(0)+';');\n"
+    "function notes(t){const n=[];if(t.port_parked)n.push('waiting for port');if(t.backend_failing)"
+    "n.push('backend failing ('+t.channel_rate+'/min)');if(t.degraded)n.push('degraded');if(t.standby)n.push('standby');"
+    "if(t.fanout_servers)n.push('fan-out '+t.fanout_up+' of '+t.fanout_servers+' up');"
+    "if(t.tags.length)n.push(t.tags.join(','));return n.join(' | ');}\n"
+    "function val(t,k){return k==='notes'?notes(t):k==='remote'?t.remote_host+':'+t.remote_port:t[k];}\n"
+    "function render(){queued=false;const f=$('filter').value.toLowerCase(),s=$('state').value;let up=0;\n"
+    "const list=[...rows.values()].filter(t=>{if(t.status==='RUNNING')up++;"
+    "if(s&&(s==='!RUNNING'?t.status==='RUNNING':t.status!==s))return false;"
+    "return !f||(t.name+' '+t.host+' '+t.tags.join(' ')+' '+t.priority).toLowerCase().includes(f);});\n"
+    "list.sort((a,b)=>{const x=val(a,key),y=val(b,key);return (x<y?-1:x>y?1:0)*dir;});\n"
+    "$('rows').innerHTML=list.map(t=>'<tr><td>'+esc(t.name)+'</td><td class=\"'+t.status+'\">'+t.status+'</td><td>'+t.type+"
+    "'</td><td>'+esc(t.user+'@'+t.host+':'+t.port)+'</td><td>'+t.local_port+'</td><td>'+esc(t.remote_host+':'+t.remote_port)+"
+    "'</td><td>'+esc(t.priority)+'</td><td>'+t.restarts+'</td><td>'+(t.probe_rtt_ms==null?'':t.probe_rtt_ms<0?"
+    "'<span class=dim>n/a</span>':t.probe_rtt_ms.toFixed(1)+' ms')+'</td><td class=dim>'+esc(notes(t))+'</td></tr>').join('');\n"
+    "$('summary').textContent=up+'/'+rows.size+' running, '+list.length+' shown';}\n"
+    "function later(){if(!queued){queued=true;requestAnimationFrame(render);}}\n"
+    "document.querySelectorAll('th').forEach(th=>th.onclick=()=>{const k=th.dataset.k;dir=k===key?-dir:1;key=k;render();});\n"
+    "$('filter').oninput=render;$('state').onchange=render;\n"
+    "const es=new EventSource('events');\n"
+    "es.onopen=()=>$('conn').textContent='';es.onerror=()=>$('conn').textContent=' (reconnecting...)';\n"
+    "es.addEventListener('snapshot',e=>{rows.clear();JSON.parse(e.data).forEach(t=>rows.set(t.name,t));render();});\n"
+    "es.addEventListener('tunnel',e=>{const t=JSON.parse(e.data);rows.set(t.name,t);later();});\n"
+    "es.addEventListener('log',e=>{const l=JSON.parse(e.data),d=document.createElement('div');\n"
+    "d.className=l.level==='error'?'ERROR':'warn';d.textContent=new Date(l.when*1000).toLocaleTimeString()+' ['+l.tunnel+'] '+l.message;\n"
+    "$('logs').prepend(d);while($('logs').children.length>50)$('logs').lastChild.remove();});\n"
+    "</script></body></html>\n";
+
+// Append to a client's output buffer. Returns -1 when the client is too far behind.
+int dash_append(dash_client_t *client, const char *data, size_t len)
+{
+    if (client->out_len + len > DASH_CLIENT_BUFFER)
+        return -1;
+    if (client->out_len + len > client->out_cap)
+    {
+        size_t cap = client->out_cap ? client->out_cap : 4096;
+        while (cap < client->out_len + len)
+            cap *= 2;
+        char *out = realloc(client->out, cap);
+        if (!out)
+            return -1;
+        client->out = out;
+        client->out_cap = cap;
+    }
+    memcpy(client->out + client->out_len, data, len);
+    client->out_len += len;
+    return 0;
+}
+
+void dash_drop(int index)
+{
+    dash_client_t *client = &dash.clients[index];
+    close(client->fd);
+    free(client->out);
+    if (client->sse)
+        dash.subscribers--;
+    dash.clients[index] = dash.clients[--dash.client_count];
+}
+
+cJSON *dash_row(const tm_tunnel_info_t *t)
+{
+    cJSON *row = cJSON_CreateObject();
+    cJSON_AddStringToObject(row, "name", t->name);
+    cJSON_AddStringToObject(row, "status", tm_status_name(t->status));
+    cJSON_AddStringToObject(row, "type", t->type == TUNNEL_TYPE_REVERSE ? "reverse" : "forward");
+    cJSON_AddStringToObject(row, "user", t->user);
+    cJSON_AddStringToObject(row, "host", t->host);
+    cJSON_AddNumberToObject(row, "port", t->port);
+    cJSON_AddNumberToObject(row, "local_port", t->local_port);
+    cJSON_AddStringToObject(row, "remote_host", t->remote_host);
+    cJSON_AddNumberToObject(row, "remote_port", t->remote_port ? t->remote_port : t->allocated_port);
+    cJSON_AddStringToObject(row, "priority", t->priority);
+    cJSON *tags = cJSON_AddArrayToObject(row, "tags");
+    for (int i = 0; i < t->tag_count; i++)
+        cJSON_AddItemToArray(tags, cJSON_CreateString(t->tags[i]));
+    cJSON_AddNumberToObject(row, "restarts", t->restart_count);
+    cJSON_AddNumberToObject(row, "last_restart", (double)t->last_restart);
+    if (t->status == TUNNEL_RUNNING && t->last_probe > 0)
+        cJSON_AddNumberToObject(row, "probe_rtt_ms", t->probe_rtt_ms);
+    else
+        cJSON_AddNullToObject(row, "probe_rtt_ms");
+    cJSON_AddBoolToObject(row, "degraded", t->degraded);
+    cJSON_AddBoolToObject(row, "standby", t->standby);
+    cJSON_AddBoolToObject(row, "port_parked", t->port_parked);
+    cJSON_AddBoolToObject(row, "backend_failing", t->backend_failing);
+    cJSON_AddNumberToObject(row, "channel_rate", t->channel_rate);
+    if (t->group_size > 0)
+    {
+        cJSON_AddNumberToObject(row, "fanout_up", t->group_up);
+        cJSON_AddNumberToObject(row, "fanout_servers", t->group_size);
+    }
+    return row;
+}
+
+// Queue an SSE message for every subscriber: the bytes are built once
+void dash_broadcast(const char *event, const char *data)
+{
+    size_t len = strlen(event) + strlen(data) + 32;
+    char *msg = malloc(len);
+    if (!msg)
+        return;
+    len = snprintf(msg, len, "event: %s\ndata: %s\n\n", event, data);
+    for (int i = 0; i < dash.client_count; i++)
+    {
+        if (dash.clients[i].sse && !dash.clients[i].dead && dash_append(&dash.clients[i], msg, len) != 0)
+            dash.clients[i].dead = 1; // Too slow: the browser reconnects and gets a fresh snapshot
+    }
+    free(msg);
+}
+
+// Broadcast a tunnel row if it differs from what subscribers have
+void dash_publish_row(const tm_tunnel_info_t *t)
+{
+    cJSON *row = dash_row(t);
+    char *text = cJSON_PrintUnformatted(row);
+    cJSON_Delete(row);
+    if (!text)
+        return;
+
+    int slot = -1;
+    for (int i = 0; i < dash.sent_count && slot < 0; i++)
+        if (strcmp(dash.sent_name[i], t->name) == 0)
+            slot = i;
+    if (slot < 0 && dash.sent_count < MAX_TUNNELS)
+    {
+        slot = dash.sent_count++;
+        snprintf(dash.sent_name[slot], MAX_NAME_LEN, "%s", t->name);
+        dash.sent_row[slot] = NULL;
+    }
+    if (slot >= 0 && dash.sent_row[slot] && strcmp(dash.sent_row[slot], text) == 0)
+    {
+        cJSON_free(text);
+        return;
+    }
+    dash_broadcast("tunnel", text);
+    if (slot >= 0)
+    {
+        cJSON_free(dash.sent_row[slot]);
+        dash.sent_row[slot] = text;
+    }
+    else
+    {
+        cJSON_free(text);
+    }
+}
+
+void dash_respond(dash_client_t *client, const char *status, const char *type, const char *body, size_t len)
+{
+    char header[256];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n",
+                     status, type, len);
+    dash_append(client, header, n);
+    dash_append(client, body, len);
+    client->close_after = 1;
+}
+
+// Handle a complete request. The subscriber gets the snapshot, then shares the broadcasts.
+void dash_handle(dash_client_t *client)
+{
+    char method[8] = "", path[256] = "";
+    sscanf(client->request, "%7s %255s", method, path);
+    char *query = strchr(path, '?');
+    if (query)
+        *query = 0;
+
+    if (strcmp(method, "GET") != 0)
+    {
+        dash_respond(client, "405 Method Not Allowed", "text/plain", "GET only\n", 9);
+        return;
+    }
+    if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0)
+    {
+        dash_respond(client, "200 OK", "text/html; charset=utf-8", dashboard_html, sizeof(dashboard_html) - 1);
+        return;
+    }
+    if (strcmp(path, "/metrics") == 0)
+    {
+        char *text = NULL;
+        size_t len = 0;
+        FILE *out = open_memstream(&text, &len);
+        if (out)
+        {
+            tm_write_metrics(dash.tm, out);
+            fclose(out);
+            dash_respond(client, "200 OK", "text/plain; version=0.0.4", text, len);
+        }
+        free(text);
+        return;
+    }
+    if (strcmp(path, "/events") != 0 && strcmp(path, "/api/tunnels") != 0)
+    {
+        dash_respond(client, "404 Not Found", "text/plain", "not found\n", 10);
+        return;
+    }
+
+    static tm_tunnel_info_t tunnels[MAX_TUNNELS];
+    int count = tm_snapshot(dash.tm, tunnels, MAX_TUNNELS);
+    cJSON *list = cJSON_CreateArray();
+    for (int i = 0; i < count; i++)
+    {
+        // Bring existing subscribers to the same state first, so the new one
+        // doesn't get its snapshot rows again as changes
+        if (strcmp(path, "/events") == 0)
+            dash_publish_row(&tunnels[i]);
+        cJSON_AddItemToArray(list, dash_row(&tunnels[i]));
+    }
+    char *text = cJSON_PrintUnformatted(list);
+    cJSON_Delete(list);
+    if (!text)
+        return;
+
+    if (strcmp(path, "/api/tunnels") == 0)
+    {
+        dash_respond(client, "200 OK", "application/json", text, strlen(text));
+    }
+    else
+    {
+        static const char header[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                                     "Connection: keep-alive\r\nX-Accel-Buffering: no\r\n\r\nretry: 2000\n\n";
+        dash_append(client, header, sizeof(header) - 1);
+        dash_append(client, "event: snapshot\ndata: ", 22);
+        dash_append(client, text, strlen(text));
+        dash_append(client, "\n\n", 2);
+        client->sse = 1;
+        dash.subscribers++;
+    }
+    cJSON_free(text);
+}
+
+// Turn queued engine events into broadcasts: changed tunnels are read once,
+// whatever the number of subscribers
+void dash_flush_events(void)
+{
+    char names[MAX_TUNNELS][MAX_NAME_LEN];
+    static dash_log_t logs[DASH_LOG_QUEUE];
+    pthread_mutex_lock(&dash.lock);
+    int dirty = dash.dirty_count, log_count = dash.log_count;
+    memcpy(names, dash.dirty, sizeof(names[0]) * dirty);
+    memcpy(logs, dash.logs, sizeof(logs[0]) * log_count);
+    dash.dirty_count = 0;
+    dash.log_count = 0;
+    pthread_mutex_unlock(&dash.lock);
+
+    if (dash.subscribers == 0)
+        return;
+    for (int i = 0; i < dirty; i++)
+    {
+        tm_tunnel_info_t info;
+        if (tm_get_tunnel(dash.tm, names[i], &info) == 0)
+            dash_publish_row(&info);
+    }
+    for (int i = 0; i < log_count; i++)
+    {
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "tunnel", logs[i].tunnel);
+        cJSON_AddNumberToObject(entry, "when", (double)logs[i].when);
+        cJSON_AddStringToObject(entry, "level", logs[i].level >= TM_LOG_ERROR ? "error" : "warn");
+        cJSON_AddStringToObject(entry, "message", logs[i].message);
+        char *text = cJSON_PrintUnformatted(entry);
+        cJSON_Delete(entry);
+        if (text)
+            dash_broadcast("log", text);
+        cJSON_free(text);
+    }
+}
+
+// Periodic diff for values that change without an event (probe RTT, degraded, ...)
+void dash_refresh(void)
+{
+    static tm_tunnel_info_t tunnels[MAX_TUNNELS];
+    int count = tm_snapshot(dash.tm, tunnels, MAX_TUNNELS);
+    for (int i = 0; i < count; i++)
+        dash_publish_row(&tunnels[i]);
+}
+
+void *dash_worker(void *arg)
+{
+    (void)arg;
+    pthread_setname_np(pthread_self(), "tm-http");
+    static struct pollfd pfds[DASH_MAX_CLIENTS + 2];
+    struct timespec last_refresh = {0}, last_ping = {0};
+
+    while (dash.running)
+    {
+        pfds[0] = (struct pollfd){.fd = dash.listen_fd, .events = dash.client_count < DASH_MAX_CLIENTS ? POLLIN : 0};
+        pfds[1] = (struct pollfd){.fd = dash.wake[0], .events = POLLIN};
+        for (int i = 0; i < dash.client_count; i++)
+            pfds[i + 2] = (struct pollfd){.fd = dash.clients[i].fd, .events = POLLIN | (dash.clients[i].out_len ? POLLOUT : 0)};
+
+        // Idle without subscribers; with them, wake for the periodic diff
+        int rc = poll(pfds, dash.client_count + 2, dash.subscribers > 0 ? DASH_REFRESH_MS : -1);
+        if (rc < 0 && errno != EINTR)
+            break;
+        if (!dash.running)
+            break;
+
+        if (rc > 0 && (pfds[1].revents & POLLIN))
+        {
+            char drain[64];
+            while (read(dash.wake[0], drain, sizeof(drain)) > 0)
+                ;
+            dash_flush_events();
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (dash.subscribers > 0 && (now.tv_sec - last_refresh.tv_sec) * 1000 + (now.tv_nsec - last_refresh.tv_nsec) / 1000000 >= DASH_REFRESH_MS)
+        {
+            dash_refresh();
+            last_refresh = now;
+        }
+        if (dash.subscribers > 0 && now.tv_sec - last_ping.tv_sec >= DASH_PING_SECS)
+        {
+            for (int i = 0; i < dash.client_count; i++)
+                if (dash.clients[i].sse && dash_append(&dash.clients[i], ": ping\n\n", 8) != 0)
+                    dash.clients[i].dead = 1;
+            last_ping = now;
+        }
+
+        // Client I/O, from the back so dropping (swap with the last) is safe.
+        // Only this loop drops clients; accepted ones are appended after it.
+        for (int i = dash.client_count - 1; i >= 0; i--)
+        {
+            dash_client_t *client = &dash.clients[i];
+            short revents = pfds[i + 2].revents;
+            if (client->dead || (revents & (POLLERR | POLLHUP)))
+            {
+                dash_drop(i);
+                continue;
+            }
+            if (revents & POLLIN)
+            {
+                char buf[1024];
+                ssize_t n = read(client->fd, buf, sizeof(buf));
+                if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR)))
+                {
+                    dash_drop(i);
+                    continue;
+                }
+                if (n > 0 && !client->sse && !client->close_after)
+                {
+                    if (client->request_len + n >= DASH_REQUEST_MAX)
+                    {
+                        dash_drop(i);
+                        continue;
+                    }
+                    memcpy(client->request + client->request_len, buf, n);
+                    client->request_len += n;
+                    client->request[client->request_len] = 0;
+                    if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n"))
+                        dash_handle(client);
+                }
+            }
+            if (client->out_len > 0)
+            {
+                ssize_t n = send(client->fd, client->out, client->out_len, MSG_NOSIGNAL);
+                if (n < 0 && errno != EAGAIN && errno != EINTR)
+                {
+                    dash_drop(i);
+                    continue;
+                }
+                if (n > 0)
+                {
+                    memmove(client->out, client->out + n, client->out_len - n);
+                    client->out_len -= n;
+                }
+            }
+            if (client->close_after && client->out_len == 0)
+                dash_drop(i);
+        }
+
+        if (rc > 0 && (pfds[0].revents & POLLIN))
+        {
+            int fd = accept4(dash.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0 && dash.client_count < DASH_MAX_CLIENTS)
+                dash.clients[dash.client_count++] = (dash_client_t){.fd = fd};
+            else if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    while (dash.client_count > 0)
+        dash_drop(dash.client_count - 1);
+    return NULL;
+}
+
+int dashboard_start(tm_manager_t *tm, const char *listen_spec)
+{
+    char host[64] = "127.0.0.1";
+    int port;
+    const char *colon = strrchr(listen_spec, ':');
+    if (colon)
+    {
+        snprintf(host, sizeof(host), "%.*s", (int)(colon - listen_spec), listen_spec);
+        port = tm_parse_int(colon + 1, 1, 65535);
+    }
+    else
+    {
+        port = tm_parse_int(listen_spec, 1, 65535);
+    }
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    if (port < 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "%s❌ Invalid --http '%s', expected [address:]port%s\n", C_ERROR, listen_spec, C_RESET);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0 ||
+        pipe2(dash.wake, O_NONBLOCK | O_CLOEXEC) != 0)
+    {
+        fprintf(stderr, "%s❌ Dashboard cannot listen on %s:%d: %s%s\n", C_ERROR, host, port, strerror(errno), C_RESET);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    dash.tm = tm;
+    dash.listen_fd = fd;
+    dash.running = 1;
+    if (pthread_create(&dash.thread, NULL, dash_worker, NULL) != 0)
+    {
+        dash.running = 0;
+        dashboard_stop();
+        return -1;
+    }
+    printf("%s🌐 Dashboard: %shttp://%s:%d/%s%s\n", C_INFO, C_BOLD, host, port, C_RESET, C_RESET);
+    return 0;
+}
+
+void dashboard_event(const tm_event_t *event)
+{
+    if (!dash.running)
+        return;
+    if (event->type == TM_EVENT_LOG && event->level < TM_LOG_WARN)
+        return;
+
+    pthread_mutex_lock(&dash.lock);
+    if (event->type == TM_EVENT_STATE)
+    {
+        int known = 0;
+        for (int i = 0; i < dash.dirty_count && !known; i++)
+            known = strcmp(dash.dirty[i], event->tunnel) == 0;
+        if (!known && dash.dirty_count < MAX_TUNNELS)
+            snprintf(dash.dirty[dash.dirty_count++], MAX_NAME_LEN, "%s", event->tunnel);
+    }
+    else if (dash.log_count < DASH_LOG_QUEUE)
+    {
+        dash_log_t *log = &dash.logs[dash.log_count++];
+        snprintf(log->tunnel, sizeof(log->tunnel), "%s", event->tunnel);
+        snprintf(log->message, sizeof(log->message), "%s", event->message);
+        log->when = event->when;
+        log->level = event->level;
+    }
+    pthread_mutex_unlock(&dash.lock);
+    (void)!write(dash.wake[1], "", 1); // Full pipe: a wakeup is pending anyway
+}
+
+void dashboard_stop(void)
+{
+    if (dash.running)
+    {
+        dash.running = 0;
+        (void)!write(dash.wake[1], "", 1);
+        pthread_join(dash.thread, NULL);
+    }
+    if (dash.listen_fd >= 0)
+        close(dash.listen_fd);
+    for (int i = 0; i < 2; i++)
+        if (dash.wake[i] >= 0)
+            close(dash.wake[i]);
+    for (int i = 0; i < dash.sent_count; i++)
+        cJSON_free(dash.sent_row[i]); // Printed by cJSON, whose allocations the engine counts
+    dash.listen_fd = dash.wake[0] = dash.wake[1] = -1;
+    dash.sent_count = 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+// Web dashboard of tunnel_manager: a static page that gets one snapshot and
+// then incremental tunnel changes over Server-Sent Events (/events), plus
+// /api/tunnels (JSON) and /metrics (Prometheus). One thread serves all
+// clients; every change is serialized once and the same bytes go to every
+// open dashboard.
+
+#include "tunnelmgr.h"
+
+// Listen on "[addr:]port" (addr defaults to 127.0.0.1) and start the server
+// thread. Returns -1 with the reason on stderr.
+int dashboard_start(tm_manager_t *tm, const char *listen_spec);
+
+// Feed engine events (from the tm_options_t callback). Only queues the change,
+// safe to call with the engine lock held.
+void dashboard_event(const tm_event_t *event);
+
+void dashboard_stop(void);
+
+#endif
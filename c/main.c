@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // accept4, open_memstream
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,737 +11,168 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <poll.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #define sleep(x) Sleep((x) * 1000)
-#define popen _popen
-#define pclose _pclose
 #define mkdir(path, mode) _mkdir(path)
 #else
 #include <ncurses.h>
 #include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
+#include <sys/un.h>
+#include <netdb.h>
+#endif
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
 #endif
 
 #include "cjson/cJSON.h"
 #include "colors.h"
+#include "compat.h"
+#include "tunnelmgr.h"
+#include "dashboard.h"
 
-#define MAX_TUNNELS 32
-#define LOG_DIR "logs"
-#define CONFIG_FILE "config.json"
-#define MAX_CMD_LEN 512
-#define MAX_NAME_LEN 64
-#define MAX_HOST_LEN 128
-#define MAX_PATH_LEN 256
-
-typedef enum
-{
-    TUNNEL_STOPPED = 0,
-    TUNNEL_STARTING,
-    TUNNEL_RUNNING,
-    TUNNEL_ERROR,
-    TUNNEL_AUTH_ERROR, // SSH key/authentication problems
-    TUNNEL_PORT_ERROR, // Port already in use
-    TUNNEL_RECONNECTING
-} tunnel_status_t;
-
-typedef enum
-{
-    TUNNEL_TYPE_FORWARD = 0, // -L (default) - Remote service accessible locally
-    TUNNEL_TYPE_REVERSE = 1  // -R - Local service accessible remotely
-} tunnel_type_t;
+// Command line client of libtunnelmgr: interactive console, sharded coordinator
+// and HA pair. All tunnel state lives in the engine behind 'engine'.
 
-typedef struct
-{
-    char name[MAX_NAME_LEN];
-    char host[MAX_HOST_LEN];
-    int port;
-    char user[MAX_NAME_LEN];
-    char ssh_key[MAX_PATH_LEN]; // SSH private key file path
-    tunnel_type_t type;         // Forward (-L) or Reverse (-R)
-    int local_port;
-    char remote_host[MAX_HOST_LEN];
-    int remote_port;
-    int reconnect_delay;
-
-    // Runtime state
-    int restart_count;
-    tunnel_status_t status;
-    time_t last_restart;
-    pthread_t thread;
-    FILE *log;
-    pid_t ssh_pid;
-    int should_run;
-} tunnel_t;
-
-typedef struct
-{
-    tunnel_t tunnels[MAX_TUNNELS];
-    int count;
-    pthread_mutex_t mutex;
-    volatile int running;
-} tunnel_manager_t;
+static tm_manager_t *engine;
+static volatile sig_atomic_t running = 1;
+static const char *config_path = CONFIG_FILE;
 
-static tunnel_manager_t manager = {0};
+// Namespace the interactive commands act on ('use'). Unscoped = all tunnels by
+// their full names; scoped = only that namespace's tunnels by their short names.
+static int scoped;
+static char scope[MAX_NAME_LEN]; // "" = default namespace
 
 // Forward declarations
-void *tunnel_worker(void *arg);
-void cleanup_manager(void);
 void signal_handler(int sig);
-int load_config(const char *filename);
-void save_config(const char *filename);
-void start_all_tunnels(void);
-void stop_all_tunnels(void);
-void start_tunnel_by_name(const char *name);
-void stop_tunnel_by_name(const char *name);
-void reset_tunnel_by_name(const char *name);
+void print_event(const tm_event_t *event, void *user);
+int start_tunnel_by_name(const char *name);
+int stop_tunnel_by_name(const char *name);
+int reset_tunnel_by_name(const char *name);
+void print_metrics(FILE *out);
 void add_tunnel_interactive(void);
 void print_status(void);
 void interactive_mode(void);
-void log_tunnel_event(tunnel_t *tunnel, const char *event);
-int test_tunnel_connectivity(tunnel_t *tunnel);
+int test_tunnel_connectivity(const tm_tunnel_info_t *tunnel);
+int name_in_scope(const char *name);
+const char *scoped_name(const char *name, char *buf, size_t len);
+int scope_filter(tm_tunnel_info_t *tunnels, int count);
 
-void log_tunnel_event(tunnel_t *tunnel, const char *event)
+// Engine log lines on stderr for better screen integration
+void print_event(const tm_event_t *event, void *user)
 {
-    if (!tunnel->log)
+    (void)user;
+    dashboard_event(event);
+    if (event->type != TM_EVENT_LOG)
         return;
 
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
     char timestamp[32];
-    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
-
-    fprintf(tunnel->log, "[%s] [Restart #%d] %s\n",
-            timestamp, tunnel->restart_count, event);
-    fflush(tunnel->log);
-
-    // Auch auf stderr für bessere Screen-Integration
-    fprintf(stderr, "%s[%s]%s %s[%s]%s %s\n",
-            C_DIM, timestamp, C_RESET,
-            C_CYAN, tunnel->name, C_RESET, event);
-}
-
-int test_tunnel_connectivity(tunnel_t *tunnel)
-{
-    // Test connectivity based on tunnel type
-    if (tunnel->type == TUNNEL_TYPE_REVERSE)
-    {
-        // For reverse tunnels, we can only test if the local service is running
-        // The remote port availability would need to be tested from the remote side
-        printf("%s🔧 Reverse tunnel test: Checking if local service on port %d is accessible%s\n",
-               C_INFO, tunnel->local_port, C_RESET);
-    }
-
-    // Simple test: try to connect to the relevant port
-#ifdef _WIN32
-    SOCKET sock;
-    struct sockaddr_in addr;
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock == INVALID_SOCKET)
-        return 0;
+    struct tm tm_info;
+    localtime_r(&event->when, &tm_info);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+    const char *color = event->level >= TM_LOG_ERROR ? C_ERROR : event->level == TM_LOG_WARN ? C_WARNING : "";
 
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(tunnel->local_port);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-    int result = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
-    closesocket(sock);
-    return (result == 0);
-#else
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
-        return 0;
-
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(tunnel->local_port);
-    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-    int result = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
-    close(sock);
-    return (result == 0);
-#endif
-}
-
-void *tunnel_worker(void *arg)
-{
-    tunnel_t *tunnel = (tunnel_t *)arg;
-    char cmd[MAX_CMD_LEN];
-    FILE *ssh_proc = NULL;
-    char output_buffer[512];
-
-    while (tunnel->should_run && manager.running)
+    // Engine-wide messages: info with the other startup lines, problems on stderr
+    if (!*event->tunnel)
     {
-        pthread_mutex_lock(&manager.mutex);
-        tunnel->status = TUNNEL_STARTING;
-        tunnel->restart_count++;
-        tunnel->last_restart = time(NULL);
-        pthread_mutex_unlock(&manager.mutex);
-
-        log_tunnel_event(tunnel, "🚀 Starting SSH tunnel");
-
-        // Build SSH command with Forward (-L) or Reverse (-R) tunneling
-        if (tunnel->type == TUNNEL_TYPE_REVERSE)
-        {
-            // Reverse tunnel: Local service accessible on remote server
-            snprintf(cmd, sizeof(cmd),
-                     "ssh -i %s -N -R %d:%s:%d %s@%s -p %d -o ConnectTimeout=10 -o ServerAliveInterval=30 -o IdentitiesOnly=yes -o BatchMode=yes -o StrictHostKeyChecking=no 2>&1",
-                     tunnel->ssh_key, tunnel->remote_port, tunnel->remote_host, tunnel->local_port,
-                     tunnel->user, tunnel->host, tunnel->port);
-        }
-        else
-        {
-            // Forward tunnel: Remote service accessible locally (default)
-            snprintf(cmd, sizeof(cmd),
-                     "ssh -i %s -N -L %d:%s:%d %s@%s -p %d -o ConnectTimeout=10 -o ServerAliveInterval=30 -o IdentitiesOnly=yes -o BatchMode=yes -o StrictHostKeyChecking=no 2>&1",
-                     tunnel->ssh_key, tunnel->local_port, tunnel->remote_host, tunnel->remote_port,
-                     tunnel->user, tunnel->host, tunnel->port);
-        }
-
-        log_tunnel_event(tunnel, "📡 Executing SSH command with BatchMode");
-
-        // Start SSH process
-        ssh_proc = popen(cmd, "r");
-        if (!ssh_proc)
-        {
-            pthread_mutex_lock(&manager.mutex);
-            tunnel->status = TUNNEL_ERROR;
-            pthread_mutex_unlock(&manager.mutex);
-
-            log_tunnel_event(tunnel, "❌ Failed to start SSH process");
-            sleep(tunnel->reconnect_delay);
-            continue;
-        }
-
-        // Give SSH a moment to establish the connection
-        sleep(2);
-
-        // Read initial output to check for immediate errors
-        int has_output = 0;
-        char all_output[1024] = {0}; // Collect all output for better debugging
-
-        while (fgets(output_buffer, sizeof(output_buffer), ssh_proc))
-        {
-            has_output = 1;
-            output_buffer[strcspn(output_buffer, "\r\n")] = 0; // Remove newlines
-            if (strlen(output_buffer) > 0)
-            {
-                // Append to all_output for logging
-                if (strlen(all_output) + strlen(output_buffer) < sizeof(all_output) - 10)
-                {
-                    if (strlen(all_output) > 0)
-                        strcat(all_output, " | ");
-                    strcat(all_output, output_buffer);
-                }
-
-                char log_msg[1024];
-                snprintf(log_msg, sizeof(log_msg), "🔍 SSH output: %s", output_buffer);
-                log_tunnel_event(tunnel, log_msg);
-            }
-        }
-
-        // Log complete output for reverse tunnel debugging
-        if (has_output && tunnel->type == TUNNEL_TYPE_REVERSE)
-        {
-            char debug_msg[1536];
-            snprintf(debug_msg, sizeof(debug_msg), "🔧 Complete SSH output for reverse tunnel: %s", all_output);
-            log_tunnel_event(tunnel, debug_msg);
-        }
-
-        // If we got immediate output, it's likely an error
-        if (has_output && (strstr(all_output, "Permission denied") ||
-                           strstr(all_output, "Connection refused") ||
-                           strstr(all_output, "Host key verification failed") ||
-                           strstr(all_output, "No such file") ||
-                           strstr(all_output, "Authentication failed") ||
-                           strstr(all_output, "Could not resolve hostname") ||
-                           strstr(all_output, "bind: Address already in use") ||
-                           strstr(all_output, "Permissions") ||
-                           strstr(all_output, "too open") ||
-                           strstr(all_output, "remote port forwarding failed") ||
-                           strstr(all_output, "Warning: remote port forwarding failed") ||
-                           strstr(all_output, "cannot listen to port") ||
-                           strstr(all_output, "bind: Cannot assign requested address")))
-        {
-
-            pthread_mutex_lock(&manager.mutex);
-            if (strstr(all_output, "Permission denied") || strstr(all_output, "Authentication failed") ||
-                strstr(all_output, "Permissions") || strstr(all_output, "too open"))
-            {
-                tunnel->status = TUNNEL_AUTH_ERROR;
-                log_tunnel_event(tunnel, "🔑 SSH authentication failed - check key and permissions");
-            }
-            else if (strstr(all_output, "bind: Address already in use") ||
-                     strstr(all_output, "remote port forwarding failed") ||
-                     strstr(all_output, "Warning: remote port forwarding failed") ||
-                     strstr(all_output, "cannot listen to port") ||
-                     strstr(all_output, "bind: Cannot assign requested address"))
-            {
-                tunnel->status = TUNNEL_PORT_ERROR;
-                if (tunnel->type == TUNNEL_TYPE_REVERSE)
-                {
-                    log_tunnel_event(tunnel, "🔒 Remote port forwarding failed - check GatewayPorts setting and port availability on server");
-                }
-                else
-                {
-                    log_tunnel_event(tunnel, "🔒 Local port already in use - check for conflicting services");
-                }
-            }
-            else
-            {
-                tunnel->status = TUNNEL_ERROR;
-                log_tunnel_event(tunnel, "❌ SSH connection failed - check host, port, and network");
-            }
-            pthread_mutex_unlock(&manager.mutex);
-
-            // If no immediate errors detected, check the process status
-            if (!has_output ||
-                !(strstr(all_output, "Permission denied") || strstr(all_output, "Connection refused") ||
-                  strstr(all_output, "remote port forwarding failed") || strstr(all_output, "bind:")))
-            {
-
-                // Give SSH more time to establish, especially for reverse tunnels
-                int wait_time = (tunnel->type == TUNNEL_TYPE_REVERSE) ? 5 : 2;
-                sleep(wait_time);
-
-                // Check if process is still alive
-                if (ssh_proc)
-                {
-                    // Try reading more output after waiting
-                    while (fgets(output_buffer, sizeof(output_buffer), ssh_proc))
-                    {
-                        output_buffer[strcspn(output_buffer, "\r\n")] = 0;
-                        if (strlen(output_buffer) > 0)
-                        {
-                            char log_msg[1024];
-                            snprintf(log_msg, sizeof(log_msg), "🔍 Delayed SSH output: %s", output_buffer);
-                            log_tunnel_event(tunnel, log_msg);
-
-                            // Check for delayed errors
-                            if (strstr(output_buffer, "Warning: remote port forwarding failed") ||
-                                strstr(output_buffer, "bind: Address already in use") ||
-                                strstr(output_buffer, "bind: Cannot assign requested address"))
-                            {
-                                pthread_mutex_lock(&manager.mutex);
-                                tunnel->status = TUNNEL_PORT_ERROR;
-                                log_tunnel_event(tunnel, "🔒 Delayed error: Remote port forwarding failed");
-                                pthread_mutex_unlock(&manager.mutex);
-
-                                pclose(ssh_proc);
-                                ssh_proc = NULL;
-                                sleep(tunnel->reconnect_delay);
-                                continue;
-                            }
-                        }
-                    }
-                }
-            }
-            else
-            {
-                pclose(ssh_proc);
-                ssh_proc = NULL;
-                sleep(tunnel->reconnect_delay);
-                continue;
-            }
-
-            pthread_mutex_lock(&manager.mutex);
-            tunnel->status = TUNNEL_RUNNING;
-            pthread_mutex_unlock(&manager.mutex);
-
-            log_tunnel_event(tunnel, "✅ Tunnel established successfully");
-
-            // Wait for process to exit (this blocks until SSH dies)
-            int exit_code = pclose(ssh_proc);
-            ssh_proc = NULL;
-
-            // Check if SSH failed (key problems, auth issues, etc.)
-            if (exit_code != 0)
-            {
-                pthread_mutex_lock(&manager.mutex);
-                // Exit code 255 usually indicates SSH authentication/connection failure
-                if (exit_code == 255)
-                {
-                    tunnel->status = TUNNEL_AUTH_ERROR;
-                    log_tunnel_event(tunnel, "🔑 SSH authentication failed (check key, permissions, host access)");
-                }
-                else
-                {
-                    tunnel->status = TUNNEL_ERROR;
-                    log_tunnel_event(tunnel, "❌ SSH process exited with error (check configuration)");
-                }
-                pthread_mutex_unlock(&manager.mutex);
-
-                sleep(tunnel->reconnect_delay);
-                continue;
-            }
-
-            pthread_mutex_lock(&manager.mutex);
-            tunnel->status = tunnel->should_run ? TUNNEL_RECONNECTING : TUNNEL_STOPPED;
-            pthread_mutex_unlock(&manager.mutex);
-
-            if (tunnel->should_run)
-            {
-                log_tunnel_event(tunnel, "💔 Tunnel died, reconnecting...");
-                sleep(tunnel->reconnect_delay);
-            }
-            else
-            {
-                log_tunnel_event(tunnel, "🛑 Tunnel stopped by user");
-                break;
-            }
-        }
-
-        pthread_mutex_lock(&manager.mutex);
-        tunnel->status = TUNNEL_STOPPED;
-        pthread_mutex_unlock(&manager.mutex);
-
-        log_tunnel_event(tunnel, "👋 Tunnel worker thread exiting");
-        return NULL;
+        fprintf(event->level >= TM_LOG_WARN ? stderr : stdout, "%s%s%s\n",
+                *color ? color : C_INFO, event->message, C_RESET);
+        return;
     }
+    char sampled[64] = "";
+    if (event->suppressed > 0)
+        snprintf(sampled, sizeof(sampled), " %s(+%d sampled out)%s", C_DIM, event->suppressed, C_RESET);
+    fprintf(stderr, "%s[%s]%s %s[%s]%s %s%s%s%s\n",
+            C_DIM, timestamp, C_RESET,
+            C_CYAN, event->tunnel, C_RESET, color, event->message, C_RESET, sampled);
 }
 
-int load_config(const char *filename)
+int start_tunnel_by_name(const char *name)
 {
-    FILE *file = fopen(filename, "r");
-    if (!file)
-    {
-        fprintf(stderr, "Error: Cannot open config file '%s': %s\n",
-                filename, strerror(errno));
-        return -1;
-    }
-
-    // Read file content
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    char *json_string = malloc(file_size + 1);
-    if (!json_string)
-    {
-        fclose(file);
-        return -1;
-    }
-
-    fread(json_string, 1, file_size, file);
-    json_string[file_size] = '\0';
-    fclose(file);
-
-    // Parse JSON
-    cJSON *json = cJSON_Parse(json_string);
-    free(json_string);
-
-    if (!json)
-    {
-        fprintf(stderr, "Error: Invalid JSON in config file\n");
-        return -1;
-    }
-
-    cJSON *tunnels_array = cJSON_GetObjectItem(json, "tunnels");
-    if (!cJSON_IsArray(tunnels_array))
-    {
-        fprintf(stderr, "Error: 'tunnels' must be an array\n");
-        cJSON_Delete(json);
-        return -1;
-    }
-
-    int tunnel_count = cJSON_GetArraySize(tunnels_array);
-    if (tunnel_count > MAX_TUNNELS)
-    {
-        fprintf(stderr, "Error: Too many tunnels (max %d)\n", MAX_TUNNELS);
-        cJSON_Delete(json);
-        return -1;
-    }
-
-    manager.count = 0;
-
-    for (int i = 0; i < tunnel_count; i++)
-    {
-        cJSON *tunnel_json = cJSON_GetArrayItem(tunnels_array, i);
-        if (!cJSON_IsObject(tunnel_json))
-            continue;
-
-        tunnel_t *tunnel = &manager.tunnels[manager.count];
-        memset(tunnel, 0, sizeof(tunnel_t));
-
-        // Parse tunnel configuration
-        cJSON *name = cJSON_GetObjectItem(tunnel_json, "name");
-        cJSON *host = cJSON_GetObjectItem(tunnel_json, "host");
-        cJSON *port = cJSON_GetObjectItem(tunnel_json, "port");
-        cJSON *user = cJSON_GetObjectItem(tunnel_json, "user");
-        cJSON *ssh_key = cJSON_GetObjectItem(tunnel_json, "ssh_key");
-        cJSON *type = cJSON_GetObjectItem(tunnel_json, "type");
-        cJSON *local_port = cJSON_GetObjectItem(tunnel_json, "local_port");
-        cJSON *remote_host = cJSON_GetObjectItem(tunnel_json, "remote_host");
-        cJSON *remote_port = cJSON_GetObjectItem(tunnel_json, "remote_port");
-        cJSON *reconnect_delay = cJSON_GetObjectItem(tunnel_json, "reconnect_delay");
-
-        if (!cJSON_IsString(name) || !cJSON_IsString(host) ||
-            !cJSON_IsNumber(port) || !cJSON_IsString(user) ||
-            !cJSON_IsString(ssh_key) || !cJSON_IsNumber(local_port) ||
-            !cJSON_IsString(remote_host) || !cJSON_IsNumber(remote_port))
-        {
-            fprintf(stderr, "Error: Invalid tunnel configuration at index %d\n", i);
-            continue;
-        }
-
-        strncpy(tunnel->name, cJSON_GetStringValue(name), MAX_NAME_LEN - 1);
-        strncpy(tunnel->host, cJSON_GetStringValue(host), MAX_HOST_LEN - 1);
-        tunnel->port = cJSON_GetNumberValue(port);
-        strncpy(tunnel->user, cJSON_GetStringValue(user), MAX_NAME_LEN - 1);
-        strncpy(tunnel->ssh_key, cJSON_GetStringValue(ssh_key), MAX_PATH_LEN - 1);
-
-        // Parse tunnel type (default: forward)
-        if (cJSON_IsString(type))
-        {
-            const char *type_str = cJSON_GetStringValue(type);
-            if (strcmp(type_str, "reverse") == 0)
-            {
-                tunnel->type = TUNNEL_TYPE_REVERSE;
-            }
-            else
-            {
-                tunnel->type = TUNNEL_TYPE_FORWARD; // default
-            }
-        }
-        else
-        {
-            tunnel->type = TUNNEL_TYPE_FORWARD; // default if not specified
-        }
-
-        tunnel->local_port = cJSON_GetNumberValue(local_port);
-        strncpy(tunnel->remote_host, cJSON_GetStringValue(remote_host), MAX_HOST_LEN - 1);
-        tunnel->remote_port = cJSON_GetNumberValue(remote_port);
-        tunnel->reconnect_delay = cJSON_IsNumber(reconnect_delay) ? cJSON_GetNumberValue(reconnect_delay) : 5;
-
-        // Validate SSH key at startup
-        struct stat key_stat;
-        if (stat(tunnel->ssh_key, &key_stat) != 0)
-        {
-            fprintf(stderr, "%s⚠️  Warning: SSH key '%s' for tunnel '%s' does not exist%s\n",
-                    C_WARNING, tunnel->ssh_key, tunnel->name, C_RESET);
-        }
-        else if ((key_stat.st_mode & 0777) > 0600)
-        {
-            fprintf(stderr, "%s⚠️  Warning: SSH key '%s' for tunnel '%s' has loose permissions (%o, should be 600)%s\n",
-                    C_WARNING, tunnel->ssh_key, tunnel->name, key_stat.st_mode & 0777, C_RESET);
-        }
-
-        // Open log file
-        char log_path[256];
-        snprintf(log_path, sizeof(log_path), "%s/%s.log", LOG_DIR, tunnel->name);
-        tunnel->log = fopen(log_path, "a");
-        if (!tunnel->log)
-        {
-            fprintf(stderr, "%s⚠️  Warning: Cannot open log file '%s' for tunnel '%s': %s%s\n",
-                    C_WARNING, log_path, tunnel->name, strerror(errno), C_RESET);
-        }
-
-        tunnel->status = TUNNEL_STOPPED;
-        tunnel->should_run = 0;
-
-        manager.count++;
-    }
-
-    cJSON_Delete(json);
-    printf("%s✅ Loaded %s%d%s tunnels from config%s\n",
-           C_SUCCESS, C_BOLD, manager.count, C_RESET, C_RESET);
-    return 0;
+    int id = tm_start_tunnel(engine, name);
+    if (id < 0)
+        printf("%s❌ Operation queue full, try again%s\n", C_ERROR, C_RESET);
+    else
+        printf("%s🚀 Start of '%s%s%s' queued (op #%d)%s\n", C_SUCCESS, C_BOLD, name, C_RESET, id, C_RESET);
+    return id;
 }
 
-void save_config(const char *filename)
+int stop_tunnel_by_name(const char *name)
 {
-    cJSON *json = cJSON_CreateObject();
-    cJSON *tunnels_arr = cJSON_CreateArray();
-
-    pthread_mutex_lock(&manager.mutex);
-    for (int i = 0; i < manager.count; i++)
-    {
-        tunnel_t *t = &manager.tunnels[i];
-        cJSON *tunnel_obj = cJSON_CreateObject();
-        cJSON_AddStringToObject(tunnel_obj, "name", t->name);
-        cJSON_AddStringToObject(tunnel_obj, "user", t->user);
-        cJSON_AddStringToObject(tunnel_obj, "host", t->host);
-        cJSON_AddNumberToObject(tunnel_obj, "port", t->port);
-        cJSON_AddStringToObject(tunnel_obj, "ssh_key", t->ssh_key);
-        cJSON_AddStringToObject(tunnel_obj, "type", t->type == TUNNEL_TYPE_REVERSE ? "reverse" : "forward");
-        cJSON_AddNumberToObject(tunnel_obj, "local_port", t->local_port);
-        cJSON_AddStringToObject(tunnel_obj, "remote_host", t->remote_host);
-        cJSON_AddNumberToObject(tunnel_obj, "remote_port", t->remote_port);
-        cJSON_AddNumberToObject(tunnel_obj, "reconnect_delay", t->reconnect_delay);
-        cJSON_AddItemToArray(tunnels_arr, tunnel_obj);
-    }
-    cJSON_AddItemToObject(json, "tunnels", tunnels_arr);
-    pthread_mutex_unlock(&manager.mutex);
-
-    char *json_string = cJSON_Print(json);
-    if (json_string)
-    {
-        FILE *file = fopen(filename, "w");
-        if (file)
-        {
-            fputs(json_string, file);
-            fclose(file);
-            printf("%s💾 Configuration saved to %s%s%s\n", C_SUCCESS, C_BOLD, filename, C_RESET);
-        }
-        else
-        {
-            fprintf(stderr, "%s❌ Failed to save config to %s%s\n", C_ERROR, filename, C_RESET);
-        }
-        free(json_string);
-    }
-    cJSON_Delete(json);
+    int id = tm_stop_tunnel(engine, name);
+    if (id < 0)
+        printf("%s❌ Operation queue full, try again%s\n", C_ERROR, C_RESET);
+    else
+        printf("%s🛑 Stop of '%s%s%s' queued (op #%d)%s\n", C_WARNING, C_BOLD, name, C_RESET, id, C_RESET);
+    return id;
 }
-//}
 
-void start_all_tunnels(void)
+int reset_tunnel_by_name(const char *name)
 {
-    for (int i = 0; i < manager.count; i++)
-    {
-        tunnel_t *tunnel = &manager.tunnels[i];
-        tunnel->should_run = 1;
-        if (pthread_create(&tunnel->thread, NULL, tunnel_worker, tunnel) != 0)
-        {
-            fprintf(stderr, "Error: Failed to create thread for tunnel '%s'\n", tunnel->name);
-            tunnel->should_run = 0;
-        }
-    }
+    int id = tm_reset_tunnel(engine, name);
+    if (id < 0)
+        printf("%s❌ Operation queue full, try again%s\n", C_ERROR, C_RESET);
+    else
+        printf("%s🔄 Reset of '%s%s%s' queued (op #%d)%s\n", C_INFO, C_BOLD, name, C_RESET, id, C_RESET);
+    return id;
 }
 
-void stop_all_tunnels(void)
+// Engine name of a tunnel as typed in the current scope, NULL (with a message)
+// if it belongs to another namespace
+const char *scoped_name(const char *name, char *buf, size_t len)
 {
-    // Signal all tunnels to stop
-    for (int i = 0; i < manager.count; i++)
-    {
-        manager.tunnels[i].should_run = 0;
-    }
-
-    // Wait for all threads to finish
-    for (int i = 0; i < manager.count; i++)
+    if (scoped && scope[0])
+        snprintf(buf, len, "%s/%s", scope, name);
+    else
+        snprintf(buf, len, "%s", name);
+    if (!name_in_scope(buf) || (scoped && scope[0] && strchr(name, '/')))
     {
-        tunnel_t *tunnel = &manager.tunnels[i];
-        if (tunnel->thread)
-        {
-            pthread_join(tunnel->thread, NULL);
-            tunnel->thread = 0;
-        }
+        printf("%s❌ Tunnel '%s' is not in namespace '%s'%s\n", C_ERROR, name, scope[0] ? scope : "default", C_RESET);
+        return NULL;
     }
+    return buf;
 }
 
-void start_tunnel_by_name(const char *name)
+int name_in_scope(const char *name)
 {
-    pthread_mutex_lock(&manager.mutex);
-    int found = 0;
-    for (int i = 0; i < manager.count; i++)
-    {
-        tunnel_t *tunnel = &manager.tunnels[i];
-        if (strcmp(tunnel->name, name) == 0)
-        {
-            if (!tunnel->should_run)
-            {
-                tunnel->should_run = 1;
-                if (pthread_create(&tunnel->thread, NULL, tunnel_worker, tunnel) == 0)
-                {
-                    printf("%s🚀 Started tunnel '%s%s%s'%s\n", C_SUCCESS, C_BOLD, name, C_RESET, C_RESET);
-                }
-                else
-                {
-                    fprintf(stderr, "%s❌ Failed to create thread for tunnel '%s'%s\n", C_ERROR, name, C_RESET);
-                    tunnel->should_run = 0;
-                }
-            }
-            else
-            {
-                printf("%s⚠️  Tunnel '%s%s%s' is already running%s\n", C_WARNING, C_BOLD, name, C_RESET, C_RESET);
-            }
-            found = 1;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&manager.mutex);
-
-    if (!found)
-    {
-        printf("%s❌ Tunnel '%s%s%s' not found%s\n", C_ERROR, C_BOLD, name, C_RESET, C_RESET);
-    }
+    if (!scoped)
+        return 1;
+    if (!scope[0])
+        return strchr(name, '/') == NULL;
+    size_t len = strlen(scope);
+    return strncmp(name, scope, len) == 0 && name[len] == '/';
 }
 
-void stop_tunnel_by_name(const char *name)
+// Drop the tunnels outside the current scope from a snapshot, returns the new count
+int scope_filter(tm_tunnel_info_t *tunnels, int count)
 {
-    pthread_mutex_lock(&manager.mutex);
-    int found = 0;
-    for (int i = 0; i < manager.count; i++)
-    {
-        tunnel_t *tunnel = &manager.tunnels[i];
-        if (strcmp(tunnel->name, name) == 0)
-        {
-            tunnel->should_run = 0;
-            if (tunnel->thread)
-            {
-                pthread_mutex_unlock(&manager.mutex); // Unlock before join
-                pthread_join(tunnel->thread, NULL);
-                pthread_mutex_lock(&manager.mutex); // Re-lock
-                tunnel->thread = 0;
-            }
-            printf("%s🛑 Stopped tunnel '%s%s%s'%s\n", C_WARNING, C_BOLD, name, C_RESET, C_RESET);
-            found = 1;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&manager.mutex);
-
-    if (!found)
-    {
-        printf("%s❌ Tunnel '%s%s%s' not found%s\n", C_ERROR, C_BOLD, name, C_RESET, C_RESET);
-    }
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+        if (!scoped || strcmp(tunnels[i].ns, scope) == 0)
+            tunnels[kept++] = tunnels[i];
+    return kept;
 }
 
-void reset_tunnel_by_name(const char *name)
+int test_tunnel_connectivity(const tm_tunnel_info_t *tunnel)
 {
-    pthread_mutex_lock(&manager.mutex);
-    int found = 0;
-    for (int i = 0; i < manager.count; i++)
+    // Test connectivity based on tunnel type
+    if (tunnel->type == TUNNEL_TYPE_REVERSE)
     {
-        tunnel_t *tunnel = &manager.tunnels[i];
-        if (strcmp(tunnel->name, name) == 0)
-        {
-            // Stop first
-            tunnel->should_run = 0;
-            if (tunnel->thread)
-            {
-                pthread_mutex_unlock(&manager.mutex); // Unlock before join
-                pthread_join(tunnel->thread, NULL);
-                pthread_mutex_lock(&manager.mutex); // Re-lock
-                tunnel->thread = 0;
-            }
-
-            // Reset restart counter
-            tunnel->restart_count = 0;
-
-            // Start again
-            tunnel->should_run = 1;
-            if (pthread_create(&tunnel->thread, NULL, tunnel_worker, tunnel) == 0)
-            {
-                printf("%s🔄 Reset tunnel '%s%s%s'%s\n", C_INFO, C_BOLD, name, C_RESET, C_RESET);
-            }
-            else
-            {
-                fprintf(stderr, "%s❌ Failed to restart tunnel '%s'%s\n", C_ERROR, name, C_RESET);
-                tunnel->should_run = 0;
-            }
-            found = 1;
-            break;
-        }
+        // For reverse tunnels, we can only test if the local service is running
+        // The remote port availability would need to be tested from the remote side
+        printf("%s🔧 Reverse tunnel test: Checking if local service on port %d is accessible%s\n",
+               C_INFO, tunnel->local_port, C_RESET);
     }
-    pthread_mutex_unlock(&manager.mutex);
 
-    if (!found)
-    {
-        printf("%s❌ Tunnel '%s%s%s' not found%s\n", C_ERROR, C_BOLD, name, C_RESET, C_RESET);
-    }
+    // Simple test: try to connect to the relevant port
+    return tm_probe_port(tunnel->local_port);
 }
 
 void add_tunnel_interactive(void)
@@ -756,14 +188,11 @@ void add_tunnel_interactive(void)
     printf("%s─────────────────────────────────────────%s\n\n", C_GREY, C_RESET);
 
     // Check if we have space
-    pthread_mutex_lock(&manager.mutex);
-    if (manager.count >= MAX_TUNNELS)
+    if (tm_count(engine) >= MAX_TUNNELS)
     {
         printf("%s❌ Maximum tunnels reached (%d/%d)%s\n", C_ERROR, MAX_TUNNELS, MAX_TUNNELS, C_RESET);
-        pthread_mutex_unlock(&manager.mutex);
         return;
     }
-    pthread_mutex_unlock(&manager.mutex);
 
     printf("%sTunnel name:%s ", C_CYAN, C_RESET);
     fgets(name, sizeof(name), stdin);
@@ -809,7 +238,7 @@ void add_tunnel_interactive(void)
 
     if (tunnel_type == TUNNEL_TYPE_REVERSE)
     {
-        printf("%sRemote port (will be opened on %s%s%s):%s ", C_CYAN, C_BOLD, host, C_RESET, C_RESET);
+        printf("%sRemote port (will be opened on %s%s%s, auto = allocated by server):%s ", C_CYAN, C_BOLD, host, C_RESET, C_RESET);
     }
     else
     {
@@ -841,7 +270,7 @@ void add_tunnel_interactive(void)
     // Validate input
     if (strlen(name) == 0 || strlen(user) == 0 || strlen(host) == 0 ||
         strlen(ssh_key) == 0 || strlen(remote_host) == 0 ||
-        port <= 0 || local_port <= 0 || remote_port <= 0)
+        port <= 0 || local_port <= 0 || remote_port < 0 || (remote_port == 0 && tunnel_type != TUNNEL_TYPE_REVERSE))
     {
         printf("%s❌ Invalid input. Tunnel not added.%s\n", C_ERROR, C_RESET);
         return;
@@ -874,58 +303,38 @@ void add_tunnel_interactive(void)
         }
     }
 
-    // Check for duplicate names
-    pthread_mutex_lock(&manager.mutex);
-    for (int i = 0; i < manager.count; i++)
+    // The engine checks for duplicate names and saves the config
+    tm_tunnel_info_t spec = {0};
+    snprintf(spec.name, sizeof(spec.name), "%s", name);
+    snprintf(spec.user, sizeof(spec.user), "%s", user);
+    snprintf(spec.host, sizeof(spec.host), "%s", host);
+    spec.port = port;
+    snprintf(spec.ssh_key, sizeof(spec.ssh_key), "%s", ssh_key);
+    spec.type = tunnel_type;
+    spec.local_port = local_port;
+    snprintf(spec.remote_host, sizeof(spec.remote_host), "%s", remote_host);
+    spec.remote_port = remote_port;
+    spec.reconnect_delay = reconnect_delay;
+
+    if (scoped)
+        snprintf(spec.ns, sizeof(spec.ns), "%s", scope);
+
+    char msg[128];
+    if (tm_add_tunnel(engine, &spec, msg, sizeof(msg)) != 0)
     {
-        if (strcmp(manager.tunnels[i].name, name) == 0)
-        {
-            printf("%s❌ Tunnel with name '%s' already exists%s\n", C_ERROR, name, C_RESET);
-            pthread_mutex_unlock(&manager.mutex);
-            return;
-        }
-    }
-
-    // Add the tunnel
-    tunnel_t *tunnel = &manager.tunnels[manager.count];
-    memset(tunnel, 0, sizeof(tunnel_t));
-
-    strncpy(tunnel->name, name, MAX_NAME_LEN - 1);
-    strncpy(tunnel->user, user, MAX_NAME_LEN - 1);
-    strncpy(tunnel->host, host, MAX_HOST_LEN - 1);
-    tunnel->port = port;
-    strncpy(tunnel->ssh_key, ssh_key, MAX_PATH_LEN - 1);
-    tunnel->type = tunnel_type;
-    tunnel->local_port = local_port;
-    strncpy(tunnel->remote_host, remote_host, MAX_HOST_LEN - 1);
-    tunnel->remote_port = remote_port;
-    tunnel->reconnect_delay = reconnect_delay;
-    tunnel->should_run = 0;
-    tunnel->status = TUNNEL_STOPPED;
-
-    // Open log file
-    char log_path[256];
-    snprintf(log_path, sizeof(log_path), "%s/%s.log", LOG_DIR, tunnel->name);
-    tunnel->log = fopen(log_path, "a");
-    if (!tunnel->log)
-    {
-        fprintf(stderr, "%s⚠️  Warning: Cannot open log file for tunnel '%s'%s\n", C_WARNING, tunnel->name, C_RESET);
+        printf("%s❌ %s%s\n", C_ERROR, msg, C_RESET);
+        return;
     }
 
-    manager.count++;
-    pthread_mutex_unlock(&manager.mutex);
-
-    // Save config
-    save_config(CONFIG_FILE);
-
     printf("\n%s✅ Tunnel '%s%s%s' added successfully!%s\n", C_SUCCESS, C_BOLD, name, C_RESET, C_RESET);
 
     // Ask if they want to start it now
     printf("%sStart tunnel now? [y/N]:%s ", C_YELLOW, C_RESET);
     fgets(input_buffer, sizeof(input_buffer), stdin);
-    if (input_buffer[0] == 'y' || input_buffer[0] == 'Y')
+    char full[MAX_NAME_LEN * 2];
+    if ((input_buffer[0] == 'y' || input_buffer[0] == 'Y') && scoped_name(name, full, sizeof(full)))
     {
-        start_tunnel_by_name(name);
+        start_tunnel_by_name(full);
     }
     printf("\n");
 }
@@ -967,19 +376,20 @@ void print_status(void)
     char timestamp[32];
     strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
 
-    printf("%sLive Status%s [%s%s%s] | Tunnels: %s%d%s\n\n",
-           C_BOLD, C_RESET, C_DIM, timestamp, C_RESET, C_BOLD, manager.count, C_RESET);
+    tm_tunnel_info_t tunnels[MAX_TUNNELS];
+    int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
 
-    pthread_mutex_lock(&manager.mutex);
+    printf("%sLive Status%s [%s%s%s] | Tunnels: %s%d%s\n\n",
+           C_BOLD, C_RESET, C_DIM, timestamp, C_RESET, C_BOLD, count, C_RESET);
 
     int running_count = 0;
     int error_count = 0;
     int auth_error_count = 0;
     int port_error_count = 0;
 
-    for (int i = 0; i < manager.count; i++)
+    for (int i = 0; i < count; i++)
     {
-        tunnel_t *tunnel = &manager.tunnels[i];
+        tm_tunnel_info_t *tunnel = &tunnels[i];
 
         // Count status
         if (tunnel->status == TUNNEL_RUNNING)
@@ -1002,14 +412,21 @@ void print_status(void)
         // Connection info
         if (tunnel->type == TUNNEL_TYPE_REVERSE)
         {
-            // Reverse: Local service accessible remotely
-            printf("%s%s%s@%s%s%s:%s%d%s %s%s%s %s%s%s:%s%d%s %s%s%s localhost:%s%d%s %s[%s]%s\n",
+            // Reverse: Local service accessible remotely ("auto" until the server allocated a port)
+            char remote[24];
+            if (tunnel->remote_port > 0)
+                snprintf(remote, sizeof(remote), "%d", tunnel->remote_port);
+            else if (tunnel->allocated_port > 0)
+                snprintf(remote, sizeof(remote), "%d (auto)", tunnel->allocated_port);
+            else
+                snprintf(remote, sizeof(remote), "auto");
+            printf("%s%s%s@%s%s%s:%s%d%s %s%s%s %s%s%s:%s%s%s %s%s%s localhost:%s%d%s %s[%s]%s\n",
                    C_DIM, tunnel->user, C_RESET,
                    C_BLUE, tunnel->host, C_RESET,
                    C_DIM, tunnel->port, C_RESET,
                    C_YELLOW, SYMBOL_ARROW, C_RESET,
                    C_GREEN, tunnel->host, C_RESET,
-                   C_GREEN, tunnel->remote_port, C_RESET,
+                   C_GREEN, remote, C_RESET,
                    C_YELLOW, SYMBOL_ARROW, C_RESET,
                    C_BLUE, tunnel->local_port, C_RESET,
                    C_DIM, type_text, C_RESET);
@@ -1040,11 +457,59 @@ void print_status(void)
             time_t diff = now - tunnel->last_restart;
             printf(" | Last: %s%lds ago%s", C_DIM, diff, C_RESET);
         }
+        printf(" | Class: %s%s%s", strcmp(tunnel->priority, "critical") == 0 ? C_RED : C_DIM,
+               tunnel->priority, C_RESET);
+        if (tunnel->status == TUNNEL_RUNNING && tunnel->last_probe > 0)
+        {
+            if (tunnel->probe_rtt_ms >= 0)
+                printf(" | Probe: %s%.1fms%s", C_DIM, tunnel->probe_rtt_ms, C_RESET);
+            else
+                printf(" | Probe: %sfailed%s", C_RED, C_RESET);
+        }
+        if (tunnel->degraded)
+            printf(" | %sDegraded%s (baseline %.1fms)", C_WARNING, C_RESET, tunnel->rtt_baseline_ms);
+        if (tunnel->remediations > 0)
+            printf(" | Remediated: %s%d (%d helped)%s", C_DIM, tunnel->remediations, tunnel->remediations_helped, C_RESET);
+        if (tunnel->port_parked)
+            printf(" | %sWaiting for port %d%s", C_WARNING, tunnel->local_port, C_RESET);
+        if (tunnel->backend_failing)
+            printf(" | %sBackend failing%s (%d channel errors/min)", C_ERROR, C_RESET, tunnel->channel_rate);
+        else if (tunnel->channel_rate > 0)
+            printf(" | Channel errors: %s%d/min%s", C_DIM, tunnel->channel_rate, C_RESET);
+        if (tunnel->standby)
+            printf(" | %sStandby%s", C_CYAN, C_RESET);
+        if (tunnel->group_size > 0)
+            printf(" | Fan-out: %s%d of %d up%s", tunnel->group_up < tunnel->group_size ? C_WARNING : C_DIM,
+                   tunnel->group_up, tunnel->group_size, C_RESET);
+        if (tunnel->window > 0)
+        {
+            char when[32];
+            struct tm tm;
+            if (tunnel->window_end > 0)
+            {
+                localtime_r(&tunnel->window_end, &tm);
+                strftime(when, sizeof(when), "%H:%M", &tm);
+                printf(" | Window: %sopen until %s%s", C_GREEN, when, C_RESET);
+            }
+            else if (tunnel->next_window > 0)
+            {
+                localtime_r(&tunnel->next_window, &tm);
+                strftime(when, sizeof(when), "%a %H:%M", &tm);
+                printf(" | Window: %snext %s (pre-warm %ds)%s", C_DIM, when, tunnel->prewarm_lead, C_RESET);
+            }
+        }
+        if (tunnel->max_session_age > 0 && tunnel->session_start > 0)
+        {
+            char age[16], limit[16];
+            printf(" | Session: %s%s / %s%s%s", C_DIM, tm_format_duration(now - tunnel->session_start, age, sizeof(age)),
+                   tm_format_duration(tunnel->max_session_age, limit, sizeof(limit)),
+                   tunnel->recycle_when_idle ? " idle" : "", C_RESET);
+            if (tunnel->session_recycles > 0)
+                printf(" %s(%d recycled, %d conn cut)%s", C_DIM, tunnel->session_recycles, tunnel->recycle_impact, C_RESET);
+        }
         printf("\n\n");
     }
 
-    pthread_mutex_unlock(&manager.mutex);
-
     // Summary bar
     printf("%s┌─ Summary ──────────────────────────────────────────────────────────────────┐%s\n", C_GREY, C_RESET);
     printf("%s│%s %sRunning:%s %s%d%s  %sErrors:%s %s%d%s  %sAuth:%s %s%d%s  %sPort:%s %s%d%s  %sTotal:%s %s%d%s %s│%s\n",
@@ -1053,7 +518,7 @@ void print_status(void)
            C_ERROR, C_RESET, C_BOLD, error_count, C_RESET,
            C_MAGENTA, C_RESET, C_BOLD, auth_error_count, C_RESET,
            C_RED, C_RESET, C_BOLD, port_error_count, C_RESET,
-           C_INFO, C_RESET, C_BOLD, manager.count, C_RESET,
+           C_INFO, C_RESET, C_BOLD, count, C_RESET,
            C_GREY, C_RESET);
     printf("%s└────────────────────────────────────────────────────────────────────────────┘%s\n\n", C_GREY, C_RESET);
 }
@@ -1066,20 +531,24 @@ void interactive_mode(void)
     print_status();
 
     printf("%s=== Interactive Command Mode ===%s\n", C_BOLD, C_RESET);
-    printf("Commands: %sstatus%s, %sstart%s [name], %sstop%s [name], %sreset%s <name>, %sadd%s, %stest%s [name], %sdebug%s [name], %sdiagnose%s, %swatch%s, %squit%s, %shelp%s\n\n",
+    printf("Commands: %sstatus%s, %sstart%s [name], %sstop%s [name], %sreset%s <name>, %sops%s, %sadd%s, %sedit%s <name> k=v, %stest%s [name], %sdebug%s [name], %sdiagnose%s, %swatch%s, %squit%s, %shelp%s\n\n",
            C_CYAN, C_RESET, C_GREEN, C_RESET, C_RED, C_RESET,
-           C_MAGENTA, C_RESET, C_BLUE, C_RESET, C_YELLOW, C_RESET,
+           C_MAGENTA, C_RESET, C_MAGENTA, C_RESET, C_BLUE, C_RESET, C_BLUE, C_RESET, C_YELLOW, C_RESET,
            C_RED, C_RESET, C_CYAN, C_RESET, C_YELLOW, C_RESET, C_MAGENTA, C_RESET, C_BLUE, C_RESET);
 
-    while (manager.running)
+    while (running)
     {
-        printf("%stunnel%s> ", C_BOLD, C_RESET);
+        if (scoped)
+            printf("%stunnel[%s]%s> ", C_BOLD, scope[0] ? scope : "default", C_RESET);
+        else
+            printf("%stunnel%s> ", C_BOLD, C_RESET);
         fflush(stdout);
 
         if (!fgets(input, sizeof(input), stdin))
         {
             break;
         }
+        char full[MAX_NAME_LEN * 2];
 
         // Remove newline
         input[strcspn(input, "\n")] = 0;
@@ -1092,8 +561,11 @@ void interactive_mode(void)
         else if (strcmp(input, "start") == 0)
         {
             printf("%s⚡ Starting all tunnels...%s\n", C_YELLOW, C_RESET);
-            start_all_tunnels();
-            printf("%s✅ All tunnels started%s\n\n", C_SUCCESS, C_RESET);
+            tm_tunnel_info_t tunnels[MAX_TUNNELS];
+            int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
+            for (int i = 0; i < count; i++)
+                start_tunnel_by_name(tunnels[i].name);
+            printf("%s✅ Start queued for all tunnels (see '%sops%s')%s\n\n", C_SUCCESS, C_BOLD, C_RESET, C_RESET);
         }
         else if (strncmp(input, "start ", 6) == 0)
         {
@@ -1102,7 +574,8 @@ void interactive_mode(void)
                 name++; // Skip leading spaces
             if (strlen(name) > 0)
             {
-                start_tunnel_by_name(name);
+                if (scoped_name(name, full, sizeof(full)))
+                    start_tunnel_by_name(full);
             }
             else
             {
@@ -1112,8 +585,11 @@ void interactive_mode(void)
         else if (strcmp(input, "stop") == 0)
         {
             printf("%s🛑 Stopping all tunnels...%s\n", C_ERROR, C_RESET);
-            stop_all_tunnels();
-            printf("%s✅ All tunnels stopped%s\n\n", C_SUCCESS, C_RESET);
+            tm_tunnel_info_t tunnels[MAX_TUNNELS];
+            int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
+            for (int i = 0; i < count; i++)
+                stop_tunnel_by_name(tunnels[i].name);
+            printf("%s✅ Stop queued for all tunnels (see '%sops%s')%s\n\n", C_SUCCESS, C_BOLD, C_RESET, C_RESET);
         }
         else if (strncmp(input, "stop ", 5) == 0)
         {
@@ -1122,7 +598,8 @@ void interactive_mode(void)
                 name++; // Skip leading spaces
             if (strlen(name) > 0)
             {
-                stop_tunnel_by_name(name);
+                if (scoped_name(name, full, sizeof(full)))
+                    stop_tunnel_by_name(full);
             }
             else
             {
@@ -1136,11 +613,157 @@ void interactive_mode(void)
                 name++; // Skip leading spaces
             if (strlen(name) > 0)
             {
-                reset_tunnel_by_name(name);
+                if (scoped_name(name, full, sizeof(full)))
+                    reset_tunnel_by_name(full);
+            }
+            else
+            {
+                printf("%s❌ Usage: reset <tunnel_name>%s\n", C_ERROR, C_RESET);
+            }
+        }
+        else if (strncmp(input, "edit ", 5) == 0)
+        {
+            char *name = input + 5;
+            while (*name == ' ')
+                name++;
+            char *fields = strchr(name, ' ');
+            if (fields)
+                *fields++ = 0;
+
+            char msg[256];
+            if (strlen(name) == 0 || !fields)
+            {
+                printf("%s❌ Usage: edit <tunnel_name> key=value [key=value ...]%s\n", C_ERROR, C_RESET);
+            }
+            else if (!scoped_name(name, full, sizeof(full)))
+            {
+                // Other namespace, reported by scoped_name()
+            }
+            else if (tm_edit_tunnel(engine, full, fields, msg, sizeof(msg)) > 0)
+            {
+                printf("%s⚙️  Tunnel '%s%s%s': %s%s\n", C_SUCCESS, C_BOLD, name, C_RESET, msg, C_RESET);
+            }
+            else
+            {
+                printf("%s❌ Edit failed: %s%s\n", C_ERROR, msg, C_RESET);
+            }
+        }
+        else if (strncmp(input, "logs ", 5) == 0)
+        {
+            // logs <name> [-n N]
+            char name[MAX_NAME_LEN] = "", flag[8] = "", count[16] = "";
+            int fields = sscanf(input + 5, "%63s %7s %15s", name, flag, count);
+            int lines = fields == 1 ? 20 : fields == 3 && strcmp(flag, "-n") == 0 ? tm_parse_int(count, 1, 100000) : -1;
+            if (fields < 1 || lines < 0)
+            {
+                printf("%s❌ Usage: logs <tunnel_name> [-n lines]%s\n", C_ERROR, C_RESET);
+            }
+            else if (scoped_name(name, full, sizeof(full)))
+            {
+                printf("%s📜 Last %d log lines of '%s%s%s':%s\n", C_INFO, lines, C_BOLD, name, C_INFO, C_RESET);
+                fflush(stdout);
+                if (tm_logs(engine, full, lines, stdout) < 0)
+                    printf("%s❌ Tunnel '%s' not found%s\n", C_ERROR, name, C_RESET);
+            }
+        }
+        else if (strncmp(input, "loglevel ", 9) == 0)
+        {
+            // loglevel <sink>[:<tunnel>] <level> [rate/s]
+            char target[MAX_NAME_LEN * 2] = "", level[16] = "";
+            int rate = -1;
+            char msg[256];
+            if (sscanf(input + 9, "%127s %15s %d", target, level, &rate) < 2)
+            {
+                printf("%s❌ Usage: loglevel <file|stderr|journal>[:<tunnel>] <debug|info|warn|error|off|default> [events/s]%s\n",
+                       C_ERROR, C_RESET);
+            }
+            else
+            {
+                char *tunnel = strchr(target, ':');
+                if (tunnel)
+                    *tunnel++ = 0;
+                if (tm_set_log_sink(engine, target, tunnel, level, rate, msg, sizeof(msg)) == 0)
+                    printf("%s📝 Log %s%s\n", C_SUCCESS, msg, C_RESET);
+                else
+                    printf("%s❌ %s%s\n", C_ERROR, msg, C_RESET);
+            }
+        }
+        else if (strncmp(input, "wait ", 5) == 0)
+        {
+            char *selector = NULL;
+            int probe = 0, timeout_s = 30, bad = 0;
+            char *save = NULL;
+            for (char *tok = strtok_r(input + 5, " ", &save); tok; tok = strtok_r(NULL, " ", &save))
+            {
+                if (strcmp(tok, "--probe") == 0)
+                    probe = 1;
+                else if (strcmp(tok, "--timeout") == 0)
+                {
+                    char *value = strtok_r(NULL, " ", &save);
+                    timeout_s = value ? tm_parse_int(value, 1, 86400) : -1;
+                    bad |= timeout_s < 0;
+                }
+                else if (!selector)
+                    selector = tok;
+                else
+                    bad = 1;
+            }
+
+            wait_result_t result;
+            if (!selector || bad)
+            {
+                printf("%s❌ Usage: wait <name|tag> [--probe] [--timeout seconds]%s\n", C_ERROR, C_RESET);
+            }
+            else if (tm_wait(engine, selector, probe, timeout_s * 1000, &result) == 0)
+            {
+                printf("%s✅ Ready: %s (waited %.0f ms)%s\n", C_SUCCESS, result.detail, result.waited_ms, C_RESET);
+            }
+            else
+            {
+                printf("%s❌ Not ready: %s (waited %.0f ms)%s\n", C_ERROR, result.detail, result.waited_ms, C_RESET);
+            }
+        }
+        else if (strcmp(input, "metrics") == 0)
+        {
+            print_metrics(stdout);
+        }
+        else if (strcmp(input, "ops") == 0)
+        {
+            tm_write_ops(engine, stdout);
+        }
+        else if (strcmp(input, "stats") == 0)
+        {
+            tm_write_stats(engine, stdout);
+        }
+        else if (strcmp(input, "namespaces") == 0)
+        {
+            tm_write_namespaces(engine, stdout);
+        }
+        else if (strcmp(input, "use") == 0 || strncmp(input, "use ", 4) == 0)
+        {
+            // use [<namespace>|default|*]
+            char target[MAX_NAME_LEN] = "";
+            sscanf(input + 3, "%63s", target);
+            tm_namespace_info_t spaces[MAX_NAMESPACES];
+            int n = tm_namespaces(engine, spaces, MAX_NAMESPACES), found = -1;
+            for (int k = 0; k < n; k++)
+                if (strcmp(spaces[k].name, strcmp(target, "default") == 0 ? "" : target) == 0)
+                    found = k;
+            if (!target[0] || strcmp(target, "*") == 0)
+            {
+                scoped = 0;
+                printf("%s🗂  All namespaces%s\n", C_INFO, C_RESET);
+            }
+            else if (found < 0)
+            {
+                printf("%s❌ Unknown namespace '%s' (see '%snamespaces%s')%s\n", C_ERROR, target, C_BOLD, C_RESET, C_RESET);
             }
             else
             {
-                printf("%s❌ Usage: reset <tunnel_name>%s\n", C_ERROR, C_RESET);
+                scoped = 1;
+                snprintf(scope, sizeof(scope), "%s", spaces[found].name);
+                printf("%s🗂  Namespace '%s%s%s': %s, logs in %s%s\n", C_INFO, C_BOLD, target, C_INFO,
+                       spaces[found].config_file, spaces[found].log_dir, C_RESET);
             }
         }
         else if (strcmp(input, "add") == 0)
@@ -1150,10 +773,11 @@ void interactive_mode(void)
         else if (strcmp(input, "test") == 0)
         {
             printf("%s🔧 Testing all tunnel connectivity...%s\n", C_INFO, C_RESET);
-            pthread_mutex_lock(&manager.mutex);
-            for (int i = 0; i < manager.count; i++)
+            tm_tunnel_info_t tunnels[MAX_TUNNELS];
+            int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
+            for (int i = 0; i < count; i++)
             {
-                tunnel_t *tunnel = &manager.tunnels[i];
+                tm_tunnel_info_t *tunnel = &tunnels[i];
                 if (tunnel->status == TUNNEL_RUNNING)
                 {
                     if (test_tunnel_connectivity(tunnel))
@@ -1172,67 +796,58 @@ void interactive_mode(void)
                     printf("%s⚠️  Tunnel '%s' is not running%s\n", C_WARNING, tunnel->name, C_RESET);
                 }
             }
-            pthread_mutex_unlock(&manager.mutex);
         }
         else if (strncmp(input, "test ", 5) == 0)
         {
             char *name = input + 5;
             while (*name == ' ')
                 name++; // Skip leading spaces
-            if (strlen(name) > 0)
+            tm_tunnel_info_t info;
+            if (strlen(name) == 0)
             {
-                pthread_mutex_lock(&manager.mutex);
-                int found = 0;
-                for (int i = 0; i < manager.count; i++)
-                {
-                    tunnel_t *tunnel = &manager.tunnels[i];
-                    if (strcmp(tunnel->name, name) == 0)
-                    {
-                        found = 1;
-                        if (tunnel->status == TUNNEL_RUNNING)
-                        {
-                            if (test_tunnel_connectivity(tunnel))
-                            {
-                                printf("%s✅ Tunnel '%s' is working (port %d accessible)%s\n",
-                                       C_SUCCESS, tunnel->name, tunnel->local_port, C_RESET);
-                            }
-                            else
-                            {
-                                printf("%s❌ Tunnel '%s' appears broken (port %d not accessible)%s\n",
-                                       C_ERROR, tunnel->name, tunnel->local_port, C_RESET);
-                            }
-                        }
-                        else
-                        {
-                            printf("%s⚠️  Tunnel '%s' is not running (status: %s)%s\n",
-                                   C_WARNING, tunnel->name,
-                                   tunnel->status == TUNNEL_AUTH_ERROR ? "AUTH-ERROR" : tunnel->status == TUNNEL_PORT_ERROR ? "PORT-ERROR"
-                                                                                    : tunnel->status == TUNNEL_ERROR        ? "ERROR"
-                                                                                                                            : "STOPPED",
-                                   C_RESET);
-                        }
-                        break;
-                    }
-                }
-                pthread_mutex_unlock(&manager.mutex);
-
-                if (!found)
-                {
+                printf("%s❌ Usage: test <tunnel_name>%s\n", C_ERROR, C_RESET);
+            }
+            else if (!scoped_name(name, full, sizeof(full)))
+            {
+                // Other namespace, reported by scoped_name()
+            }
+            else if (tm_get_tunnel(engine, full, &info) != 0)
+            {
+                // A fan-out name: the port test is per exposure (svc@host)
+                tm_tunnel_info_t tunnels[MAX_TUNNELS];
+                int count = tm_snapshot(engine, tunnels, MAX_TUNNELS), i = 0;
+                while (i < count && strcmp(tunnels[i].group, full) != 0)
+                    i++;
+                if (i < count)
+                    printf("%s⚠️  '%s' is a fan-out, test one exposure (e.g. 'test %s')%s\n",
+                           C_WARNING, name, tunnels[i].name, C_RESET);
+                else
                     printf("%s❌ Tunnel '%s' not found%s\n", C_ERROR, name, C_RESET);
-                }
+            }
+            else if (info.status != TUNNEL_RUNNING)
+            {
+                printf("%s⚠️  Tunnel '%s' is not running (status: %s)%s\n",
+                       C_WARNING, info.name, tm_status_name(info.status), C_RESET);
+            }
+            else if (test_tunnel_connectivity(&info))
+            {
+                printf("%s✅ Tunnel '%s' is working (port %d accessible)%s\n",
+                       C_SUCCESS, info.name, info.local_port, C_RESET);
             }
             else
             {
-                printf("%s❌ Usage: test <tunnel_name>%s\n", C_ERROR, C_RESET);
+                printf("%s❌ Tunnel '%s' appears broken (port %d not accessible)%s\n",
+                       C_ERROR, info.name, info.local_port, C_RESET);
             }
         }
         else if (strcmp(input, "debug") == 0)
         {
             printf("%s🐛 Debug: Testing SSH commands for all tunnels%s\n", C_WARNING, C_RESET);
-            pthread_mutex_lock(&manager.mutex);
-            for (int i = 0; i < manager.count; i++)
+            tm_tunnel_info_t tunnels[MAX_TUNNELS];
+            int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
+            for (int i = 0; i < count; i++)
             {
-                tunnel_t *tunnel = &manager.tunnels[i];
+                tm_tunnel_info_t *tunnel = &tunnels[i];
                 char cmd[MAX_CMD_LEN];
 
                 printf("\n%s%s [%s]:%s\n", C_CYAN, tunnel->name,
@@ -1255,21 +870,21 @@ void interactive_mode(void)
 
                 printf("%s📝 SSH Command:%s\n%s%s%s\n", C_DIM, C_RESET, C_YELLOW, cmd, C_RESET);
             }
-            pthread_mutex_unlock(&manager.mutex);
         }
         else if (strncmp(input, "debug ", 6) == 0)
         {
             char *name = input + 6;
             while (*name == ' ')
                 name++;
-            if (strlen(name) > 0)
+            if (strlen(name) > 0 && scoped_name(name, full, sizeof(full)))
             {
-                pthread_mutex_lock(&manager.mutex);
+                tm_tunnel_info_t tunnels[MAX_TUNNELS];
+                int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
                 int found = 0;
-                for (int i = 0; i < manager.count; i++)
+                for (int i = 0; i < count; i++)
                 {
-                    tunnel_t *tunnel = &manager.tunnels[i];
-                    if (strcmp(tunnel->name, name) == 0)
+                    tm_tunnel_info_t *tunnel = &tunnels[i];
+                    if (strcmp(tunnel->name, full) == 0)
                     {
                         found = 1;
                         char cmd[MAX_CMD_LEN];
@@ -1297,108 +912,776 @@ void interactive_mode(void)
                         break;
                     }
                 }
-                pthread_mutex_unlock(&manager.mutex);
 
                 if (!found)
                 {
                     printf("%s❌ Tunnel '%s' not found%s\n", C_ERROR, name, C_RESET);
                 }
             }
-            else
+            else if (strlen(name) == 0)
             {
                 printf("%s❌ Usage: debug <tunnel_name>%s\n", C_ERROR, C_RESET);
             }
         }
-        else if (strcmp(input, "diagnose") == 0)
-        {
-            printf("%s🔧 System Diagnostics%s\n\n", C_BOLD, C_RESET);
+        else if (strcmp(input, "diagnose") == 0 || strncmp(input, "diagnose ", 9) == 0)
+        {
+            // diagnose [name] [--fresh]
+            char *name = NULL;
+            int fresh = 0;
+            char *save = NULL;
+            for (char *tok = strtok_r(input + 8, " ", &save); tok; tok = strtok_r(NULL, " ", &save))
+            {
+                if (strcmp(tok, "--fresh") == 0)
+                    fresh = 1;
+                else
+                    name = tok;
+            }
+            if (name && !(name = (char *)scoped_name(name, full, sizeof(full))))
+                continue;
+            printf("%s🔧 System Diagnostics%s\n\n", C_BOLD, C_RESET);
+
+            // Check logs directory
+            struct stat logs_stat;
+            if (stat(LOG_DIR, &logs_stat) == 0)
+            {
+                printf("%s✅ Logs directory '%s' exists and is accessible%s\n", C_SUCCESS, LOG_DIR, C_RESET);
+            }
+            else
+            {
+                printf("%s❌ Logs directory '%s' is not accessible: %s%s\n", C_ERROR, LOG_DIR, strerror(errno), C_RESET);
+            }
+
+            // Check config file
+            struct stat config_stat;
+            if (stat(config_path, &config_stat) == 0)
+            {
+                printf("%s✅ Config file '%s' exists and is readable%s\n", C_SUCCESS, config_path, C_RESET);
+            }
+            else
+            {
+                printf("%s❌ Config file '%s' is not accessible: %s%s\n", C_ERROR, config_path, strerror(errno), C_RESET);
+            }
+
+            // Count tunnel types
+            int reverse_count = 0, forward_count = 0;
+            tm_tunnel_info_t tunnels[MAX_TUNNELS];
+            int count = scope_filter(tunnels, tm_snapshot(engine, tunnels, MAX_TUNNELS));
+            for (int i = 0; i < count; i++)
+            {
+                if (tunnels[i].type == TUNNEL_TYPE_REVERSE)
+                    reverse_count++;
+                else
+                    forward_count++;
+            }
+
+            printf("\n%sTunnel Type Distribution:%s\n", C_BOLD, C_RESET);
+            printf("  %sForward tunnels (-L):%s %d\n", C_GREEN, C_RESET, forward_count);
+            printf("  %sReverse tunnels (-R):%s %d\n", C_MAGENTA, C_RESET, reverse_count);
+
+            if (reverse_count > 0)
+            {
+                printf("\n%s⚠️  Reverse Tunnel Requirements:%s\n", C_WARNING, C_RESET);
+                printf("  • Remote server must have '%sGatewayPorts yes%s' in /etc/ssh/sshd_config\n", C_YELLOW, C_RESET);
+                printf("  • Remote ports must be available (not in use)\n");
+                printf("  • Firewall must allow the remote ports\n");
+                printf("  • Use '%ssudo systemctl reload sshd%s' after config changes\n", C_YELLOW, C_RESET);
+            }
+
+            // Per-tunnel checks run in parallel inside the engine (cached for a while)
+            printf("\n%sChecks%s%s:%s\n", C_BOLD, fresh ? "" : " (cached results marked)",
+                   name ? "" : " for all tunnels", C_RESET);
+            static tm_check_t checks[MAX_TUNNELS * 8];
+            struct timespec started;
+            clock_gettime(CLOCK_MONOTONIC, &started);
+            int n = tm_diagnose(engine, name, fresh, checks, MAX_TUNNELS * 8);
+            struct timespec finished;
+            clock_gettime(CLOCK_MONOTONIC, &finished);
+            if (n < 0)
+                printf("%s❌ Tunnel '%s' not found%s\n", C_ERROR, name, C_RESET);
+            const char *last = NULL;
+            int problems = 0;
+            for (int i = 0; i < n; i++)
+            {
+                tm_check_t *check = &checks[i];
+                if (check->tunnel[0] && !name_in_scope(check->tunnel))
+                    continue;
+                if (!last || strcmp(last, check->tunnel) != 0)
+                {
+                    printf("  %s%s%s\n", C_CYAN, check->tunnel[0] ? check->tunnel : "(global)", C_RESET);
+                    last = check->tunnel;
+                }
+                static const char *marks[] = {"✅", "⚠️ ", "❌", "⏱️ ", "➖"};
+                const char *color = check->result == TM_CHECK_OK     ? C_SUCCESS
+                                    : check->result == TM_CHECK_WARN ? C_WARNING
+                                    : check->result == TM_CHECK_SKIPPED ? C_DIM
+                                                                        : C_ERROR;
+                char age[24] = "";
+                if (check->age >= 0)
+                    snprintf(age, sizeof(age), " (cached %ds)", check->age);
+                printf("    %s %s%-10s%s %s%7.1fms%s  %s%s%s%s%s%s\n", marks[check->result], C_BOLD, check->check, C_RESET,
+                       C_DIM, check->ms, C_RESET, color, check->detail, C_RESET, C_DIM, age, C_RESET);
+                if (check->result == TM_CHECK_WARN || check->result == TM_CHECK_FAIL || check->result == TM_CHECK_TIMEOUT)
+                    problems++;
+            }
+            double took = (finished.tv_sec - started.tv_sec) * 1000.0 + (finished.tv_nsec - started.tv_nsec) / 1e6;
+            if (n >= 0)
+                printf("\n%s%d checks, %d problems, %.0f ms%s\n", problems ? C_WARNING : C_SUCCESS, n, problems, took, C_RESET);
+            printf("\n");
+        }
+        else if (strcmp(input, "watch") == 0)
+        {
+            printf("%s🔄 Entering watch mode (press Ctrl+C to exit)...%s\n\n", C_INFO, C_RESET);
+            while (running)
+            {
+                print_status();
+                printf("%sRefreshing in 2 seconds... (Ctrl+C to exit watch mode)%s\n", C_DIM, C_RESET);
+                tm_tick_sleep(engine, 2);
+            }
+        }
+        else if (strcmp(input, "quit") == 0 || strcmp(input, "exit") == 0)
+        {
+            printf("%s👋 Chief Tunnel Officer signing off...%s\n", C_INFO, C_RESET);
+            break;
+        }
+        else if (strcmp(input, "help") == 0)
+        {
+            printf("\n%s📋 Available Commands:%s\n", C_BOLD, C_RESET);
+            printf("  %sstatus%s       - Show tunnel status (default)\n", C_CYAN, C_RESET);
+            printf("  %sstart%s        - Start all tunnels\n", C_GREEN, C_RESET);
+            printf("  %sstart <name>%s - Start specific tunnel\n", C_GREEN, C_RESET);
+            printf("  %sstop%s         - Stop all tunnels\n", C_RED, C_RESET);
+            printf("  %sstop <name>%s  - Stop specific tunnel\n", C_RED, C_RESET);
+            printf("  %sreset <name>%s - Restart specific tunnel\n", C_MAGENTA, C_RESET);
+            printf("  %sops%s          - Show queued/completed operations with latency\n", C_MAGENTA, C_RESET);
+            printf("  %swait <name|tag> [--probe] [--timeout s]%s - Block until tunnels are ready\n", C_GREEN, C_RESET);
+            printf("  %smetrics%s      - Prometheus metrics (incl. per-class MTTR)\n", C_CYAN, C_RESET);
+            printf("  %sstats%s        - Manager self-telemetry: CPU per thread, allocations, syscalls\n", C_CYAN, C_RESET);
+            printf("  %snamespaces%s   - Tunnels, quotas and handshakes per namespace, measured daemon cost\n", C_CYAN, C_RESET);
+            printf("  %suse <ns>%s     - Limit commands to one namespace (short names), 'use' = all\n", C_CYAN, C_RESET);
+            printf("  %sadd%s          - Add new tunnel interactively\n", C_BLUE, C_RESET);
+            printf("  %sedit <name> k=v%s - Change tunnel settings live (e.g. reconnect_delay=10)\n", C_BLUE, C_RESET);
+            printf("  %stest%s         - Test all tunnel connectivity\n", C_YELLOW, C_RESET);
+            printf("  %stest <name>%s  - Test specific tunnel connectivity\n", C_YELLOW, C_RESET);
+            printf("  %sdebug%s        - Show SSH commands for all tunnels\n", C_RED, C_RESET);
+            printf("  %sdebug <name>%s - Show SSH command for specific tunnel\n", C_RED, C_RESET);
+            printf("  %sdiagnose [name] [--fresh]%s - Parallel checks: keys, DNS, TCP, sshd banner, ports, agent\n", C_CYAN, C_RESET);
+            printf("  %slogs <name> [-n N]%s - Recent events and SSH output of a tunnel\n", C_DIM, C_RESET);
+            printf("  %sloglevel <sink>[:<name>] <level> [n/s]%s - Level and sampling per log sink (file, stderr, journal)\n", C_DIM, C_RESET);
+            printf("  %swatch%s        - Live status updates (refresh every 2s)\n", C_YELLOW, C_RESET);
+            printf("  %squit%s         - Exit program\n", C_MAGENTA, C_RESET);
+            printf("  %shelp%s         - Show this help\n\n", C_BLUE, C_RESET);
+            printf("%s💡 Examples:%s\n", C_BOLD, C_RESET);
+            printf("  start db-prod   %s# Start specific tunnel%s\n", C_DIM, C_RESET);
+            printf("  stop web-dev    %s# Stop specific tunnel%s\n", C_DIM, C_RESET);
+            printf("  test db-prod    %s# Test if tunnel is really working%s\n", C_DIM, C_RESET);
+            printf("  diagnose        %s# Check system health and SSH keys%s\n", C_DIM, C_RESET);
+            printf("  reset api-test  %s# Restart tunnel with reset counter%s\n\n", C_DIM, C_RESET);
+
+            printf("%s🔄 Tunnel Types:%s\n", C_BOLD, C_RESET);
+            printf("  %sForward (-L):%s Remote service → Local access\n", C_GREEN, C_RESET);
+            printf("  %sReverse (-R):%s Local service → Remote access\n", C_MAGENTA, C_RESET);
+            printf("  %sExample:%s ssh -R 6983:127.0.0.1:2283 user@server\n", C_DIM, C_RESET);
+            printf("           %s# Opens port 6983 on server, forwards to local 2283%s\n\n", C_DIM, C_RESET);
+        }
+        else if (strlen(input) > 0)
+        {
+            printf("%s❌ Unknown command: %s%s%s (type '%shelp%s' for commands)%s\n\n",
+                   C_ERROR, C_BOLD, input, C_RESET, C_BLUE, C_RESET, C_RESET);
+        }
+    }
+}
+
+// ─── Sharded mode ───────────────────────────────────────────────────────────
+// A coordinator process partitions tunnels across N shard processes by host hash.
+// Each shard is this binary started with --shard i/N: a headless supervisor for its
+// subset that answers line commands on logs/shard-<i>.sock. A crash or stall in one
+// shard only affects the tunnels it owns.
+
+#define MAX_SHARDS 64
+
+typedef struct
+{
+    pid_t pid;
+    int restarts;
+    time_t started;
+    time_t respawn_at;       // Crash-loop guard
+    unsigned long signature; // Hash of the assigned tunnel names
+    int tunnels;
+} shard_t;
+
+typedef struct
+{
+    shard_t shards[MAX_SHARDS];
+    int count;
+    const char *config_file;
+    time_t config_mtime;
+    char exe[MAX_PATH_LEN];
+    char names[MAX_TUNNELS][MAX_NAME_LEN]; // Tunnel -> shard routing table
+    int owner[MAX_TUNNELS];
+    int tunnel_count;
+    pthread_mutex_t lock;
+    pthread_t monitor;
+} shard_coordinator_t;
+
+static shard_coordinator_t coordinator = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// Sharded mode: this process supervises shard 'shard_index' of 'shard_count' (0 = unsharded)
+static int shard_index;
+static int shard_count;
+
+// FNV-1a
+unsigned long host_hash(const char *text)
+{
+    unsigned long h = 2166136261UL;
+    for (; *text; text++)
+        h = (h ^ (unsigned char)*text) * 16777619UL;
+    return h;
+}
+
+void shard_socket_path(int shard, char *buf, size_t len)
+{
+    snprintf(buf, len, "%s/shard-%d.sock", LOG_DIR, shard);
+}
+
+// Shard process: engine load filter, keeps only the tunnels this shard owns
+int shard_filter(const char *name, const char *host, void *user)
+{
+    (void)name;
+    (void)user;
+    return (int)(host_hash(host) % shard_count) == shard_index;
+}
+
+// Shard process: execute one control line and write the reply to out
+void shard_handle_command(char *line, FILE *out)
+{
+    line[strcspn(line, "\r\n")] = 0;
+    char *arg = strchr(line, ' ');
+    if (arg)
+    {
+        *arg++ = 0;
+        while (*arg == ' ')
+            arg++;
+    }
+
+    if (strcmp(line, "status") == 0)
+    {
+        // name, status, restarts, seconds since last restart, probe rtt
+        time_t now = time(NULL);
+        tm_tunnel_info_t tunnels[MAX_TUNNELS];
+        int count = tm_snapshot(engine, tunnels, MAX_TUNNELS);
+        for (int i = 0; i < count; i++)
+        {
+            tm_tunnel_info_t *t = &tunnels[i];
+            fprintf(out, "%s\t%d\t%d\t%ld\t%.1f\n", t->name, t->status, t->restart_count,
+                    t->last_restart ? (long)(now - t->last_restart) : -1L,
+                    t->last_probe ? t->probe_rtt_ms : -1.0);
+        }
+    }
+    else if (strcmp(line, "metrics") == 0)
+    {
+        print_metrics(out);
+    }
+    else if (strcmp(line, "ops") == 0)
+    {
+        tm_write_ops(engine, out);
+    }
+    else if (strcmp(line, "stats") == 0)
+    {
+        tm_write_stats(engine, out);
+    }
+    else if (strcmp(line, "start") == 0 || strcmp(line, "stop") == 0 || strcmp(line, "reset") == 0)
+    {
+        op_type_t type = line[2] == 'a' ? OP_START : (line[2] == 'o' ? OP_STOP : OP_RESET);
+        tm_tunnel_info_t tunnels[MAX_TUNNELS];
+        int count = 1;
+        if (!arg || !*arg)
+            count = tm_snapshot(engine, tunnels, MAX_TUNNELS);
+        for (int i = 0; i < count; i++)
+        {
+            // A named target goes to the engine as is, it expands fan-out groups itself
+            const char *name = arg && *arg ? arg : tunnels[i].name;
+            int id = type == OP_START ? tm_start_tunnel(engine, name)
+                                      : (type == OP_STOP ? tm_stop_tunnel(engine, name) : tm_reset_tunnel(engine, name));
+            if (id < 0)
+                fprintf(out, "%s❌ Operation queue full, try again%s\n", C_ERROR, C_RESET);
+            else
+                fprintf(out, "%s📨 %s of '%s' queued (shard %d, op #%d)%s\n", C_SUCCESS,
+                        tm_op_name(type), name, shard_index, id, C_RESET);
+        }
+    }
+    else if (strcmp(line, "edit") == 0 && arg)
+    {
+        char *assignments = strchr(arg, ' ');
+        char msg[256];
+        if (assignments)
+            *assignments++ = 0;
+        if (tm_edit_tunnel(engine, arg, assignments ? assignments : "", msg, sizeof(msg)) < 0)
+            fprintf(out, "%s❌ Edit failed: %s%s\n", C_ERROR, msg, C_RESET);
+        else
+            fprintf(out, "%s⚙️  Tunnel '%s': %s%s\n", C_SUCCESS, arg, msg, C_RESET);
+    }
+    else if (strcmp(line, "quit") == 0)
+    {
+        running = 0;
+        fprintf(out, "bye\n");
+    }
+    else
+    {
+        fprintf(out, "%s❌ Unknown shard command: %s%s\n", C_ERROR, line, C_RESET);
+    }
+}
+
+// Shard process main loop: serve the control socket until shutdown
+void shard_serve(void)
+{
+    pid_t coordinator_pid = getppid();
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    shard_socket_path(shard_index, addr.sun_path, sizeof(addr.sun_path));
+    unlink(addr.sun_path);
+
+    int srv = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (srv < 0 || bind(srv, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(srv, 16) != 0)
+    {
+        fprintf(stderr, "%s❌ Shard %d: cannot listen on %s: %s%s\n",
+                C_ERROR, shard_index, addr.sun_path, strerror(errno), C_RESET);
+        if (srv >= 0)
+            close(srv);
+        return;
+    }
+
+    while (running)
+    {
+        // Reparented: the coordinator is gone (covers systems without PR_SET_PDEATHSIG)
+        if (getppid() != coordinator_pid)
+            break;
+        struct pollfd pfd = {.fd = srv, .events = POLLIN};
+        if (poll(&pfd, 1, 1000) <= 0)
+            continue;
+
+        int fd = accept4(srv, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+            continue;
+        struct timeval tv = {.tv_sec = 2};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        FILE *conn = fdopen(fd, "r+");
+        if (!conn)
+        {
+            close(fd);
+            continue;
+        }
+        char line[512];
+        if (fgets(line, sizeof(line), conn))
+        {
+            fseek(conn, 0, SEEK_CUR); // Switch the stream from reading to writing
+            shard_handle_command(line, conn);
+        }
+        fclose(conn);
+    }
+
+    close(srv);
+    unlink(addr.sun_path);
+}
+
+// Coordinator: send one command to a shard and copy the reply to out.
+// Returns -1 if the shard is unreachable.
+int shard_request(int shard, const char *cmd, FILE *out)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    shard_socket_path(shard, addr.sun_path, sizeof(addr.sun_path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    struct timeval tv = {.tv_sec = 5};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    dprintf(fd, "%s\n", cmd);
+    shutdown(fd, SHUT_WR);
+
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        fwrite(buf, 1, n, out);
+    close(fd);
+    return n < 0 ? -1 : 0;
+}
+
+// Coordinator: read the config and compute the tunnel -> shard routing table.
+// Only names and hosts matter here, the shards parse the full config themselves.
+int shard_plan_load(void)
+{
+    char *text = tm_read_file(coordinator.config_file);
+    cJSON *json = text ? cJSON_Parse(text) : NULL;
+    free(text);
+    cJSON *tunnels = cJSON_GetObjectItem(json, "tunnels");
+    if (!cJSON_IsArray(tunnels))
+    {
+        cJSON_Delete(json);
+        return -1;
+    }
+
+    pthread_mutex_lock(&coordinator.lock);
+    for (int s = 0; s < coordinator.count; s++)
+    {
+        coordinator.shards[s].signature = 2166136261UL;
+        coordinator.shards[s].tunnels = 0;
+    }
+    coordinator.tunnel_count = 0;
+
+    cJSON *item;
+    cJSON_ArrayForEach(item, tunnels)
+    {
+        const char *name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "name"));
+        const char *host = cJSON_GetStringValue(cJSON_GetObjectItem(item, "host"));
+        cJSON *hosts = cJSON_GetObjectItem(item, "hosts");
+        if (!host) // Fan-out: the whole group goes where its first host goes
+            host = cJSON_GetStringValue(cJSON_GetArrayItem(hosts, 0));
+        if (!name || !host || coordinator.tunnel_count >= MAX_TUNNELS)
+            continue;
+
+        int s = (int)(host_hash(host) % coordinator.count);
+        int i = coordinator.tunnel_count++;
+        snprintf(coordinator.names[i], MAX_NAME_LEN, "%s", name);
+        coordinator.owner[i] = s;
+        shard_t *shard = &coordinator.shards[s];
+        shard->tunnels++;
+        shard->signature = (shard->signature ^ host_hash(name)) * 16777619UL;
+
+        // Route the exposures ("<name>@<host>") of a fan-out group to the same shard
+        cJSON *fanout_host;
+        if (!cJSON_IsArray(hosts) || cJSON_GetObjectItem(item, "host"))
+            continue;
+        cJSON_ArrayForEach(fanout_host, hosts)
+        {
+            const char *exposure = cJSON_GetStringValue(fanout_host);
+            if (!exposure || coordinator.tunnel_count >= MAX_TUNNELS)
+                continue;
+            i = coordinator.tunnel_count++;
+            snprintf(coordinator.names[i], MAX_NAME_LEN, "%s@%s", name, exposure);
+            coordinator.owner[i] = s;
+            shard->tunnels += fanout_host != hosts->child; // The group entry counted the first one
+        }
+    }
+    pthread_mutex_unlock(&coordinator.lock);
+    cJSON_Delete(json);
+    return 0;
+}
+
+// Coordinator: fork/exec one shard process. Caller holds coordinator.lock.
+void shard_spawn(int s)
+{
+    char shard_arg[32];
+    snprintf(shard_arg, sizeof(shard_arg), "%d/%d", s, coordinator.count);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+#ifdef __linux__
+        prctl(PR_SET_PDEATHSIG, SIGTERM); // Never outlive the coordinator (elsewhere shard_serve checks the parent)
+#endif
+        int devnull = open("/dev/null", O_RDONLY);
+        if (devnull >= 0)
+            dup2(devnull, STDIN_FILENO);
+        execl(coordinator.exe, coordinator.exe, coordinator.config_file, "--shard", shard_arg, (char *)NULL);
+        _exit(127);
+    }
+
+    shard_t *shard = &coordinator.shards[s];
+    shard->pid = pid > 0 ? pid : 0;
+    shard->started = time(NULL);
+    if (pid < 0)
+        fprintf(stderr, "%s❌ Failed to fork shard %d: %s%s\n", C_ERROR, s, strerror(errno), C_RESET);
+}
+
+// Coordinator: stop a shard and wait for it. Caller holds coordinator.lock.
+void shard_terminate(int s)
+{
+    shard_t *shard = &coordinator.shards[s];
+    if (shard->pid <= 0)
+        return;
+    kill(shard->pid, SIGTERM);
+    waitpid(shard->pid, NULL, 0);
+    shard->pid = 0;
+}
+
+// Coordinator monitor: respawns crashed shards and rebalances on config changes
+void *coordinator_monitor(void *arg)
+{
+    (void)arg;
+    pthread_setname_np(pthread_self(), "tm-shards");
+    while (running)
+    {
+        sleep(1);
+        time_t now = time(NULL);
+
+        // Config edits (also those made through a shard's "edit") may move tunnels
+        struct stat st;
+        if (stat(coordinator.config_file, &st) == 0 && st.st_mtime != coordinator.config_mtime)
+        {
+            unsigned long before[MAX_SHARDS];
+            for (int s = 0; s < coordinator.count; s++)
+                before[s] = coordinator.shards[s].signature;
+            coordinator.config_mtime = st.st_mtime;
+
+            if (shard_plan_load() == 0)
+            {
+                pthread_mutex_lock(&coordinator.lock);
+                for (int s = 0; s < coordinator.count && running; s++)
+                {
+                    if (coordinator.shards[s].signature == before[s])
+                        continue;
+                    printf("%s🔀 Config changed, rebalancing shard %d (%d tunnels)%s\n",
+                           C_INFO, s, coordinator.shards[s].tunnels, C_RESET);
+                    shard_terminate(s);
+                    shard_spawn(s);
+                }
+                pthread_mutex_unlock(&coordinator.lock);
+            }
+        }
 
-            // Check logs directory
-            struct stat logs_stat;
-            if (stat(LOG_DIR, &logs_stat) == 0)
+        pthread_mutex_lock(&coordinator.lock);
+        for (int s = 0; s < coordinator.count && running; s++)
+        {
+            shard_t *shard = &coordinator.shards[s];
+            int status;
+            if (shard->pid > 0 && waitpid(shard->pid, &status, WNOHANG) == shard->pid)
             {
-                printf("%s✅ Logs directory '%s' exists and is accessible%s\n", C_SUCCESS, LOG_DIR, C_RESET);
+                printf("%s💥 Shard %d (pid %d) exited with status %d, its tunnels are down%s\n",
+                       C_ERROR, s, shard->pid, WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status), C_RESET);
+                shard->pid = 0;
+                // Back off if it died right after starting
+                shard->respawn_at = now - shard->started < 5 ? now + 5 : now;
             }
-            else
+            if (shard->pid == 0 && now >= shard->respawn_at)
             {
-                printf("%s❌ Logs directory '%s' is not accessible: %s%s\n", C_ERROR, LOG_DIR, strerror(errno), C_RESET);
+                shard->restarts++;
+                printf("%s♻️  Respawning shard %d%s\n", C_WARNING, s, C_RESET);
+                shard_spawn(s);
             }
+        }
+        pthread_mutex_unlock(&coordinator.lock);
+    }
+    return NULL;
+}
 
-            // Check config file
-            struct stat config_stat;
-            if (stat(CONFIG_FILE, &config_stat) == 0)
+// Coordinator: shard owning a tunnel, -1 if unknown
+int shard_of(const char *name)
+{
+    int owner = -1;
+    pthread_mutex_lock(&coordinator.lock);
+    for (int i = 0; i < coordinator.tunnel_count; i++)
+    {
+        if (strcmp(coordinator.names[i], name) == 0)
+            owner = coordinator.owner[i];
+    }
+    pthread_mutex_unlock(&coordinator.lock);
+    return owner;
+}
+
+void coordinator_print_status(void)
+{
+    const char *colors[] = {C_GREY, C_YELLOW, C_GREEN, C_RED, C_MAGENTA, C_RED, C_YELLOW};
+    int running = 0, total = 0;
+
+    printf("\n%s📊 Tunnel Status (sharded, %d shards)%s\n", C_BOLD, coordinator.count, C_RESET);
+    for (int s = 0; s < coordinator.count; s++)
+    {
+        char *reply = NULL;
+        size_t len = 0;
+        FILE *mem = open_memstream(&reply, &len);
+        int rc = shard_request(s, "status", mem);
+        fclose(mem);
+
+        pthread_mutex_lock(&coordinator.lock);
+        pid_t pid = coordinator.shards[s].pid;
+        int tunnels = coordinator.shards[s].tunnels;
+        pthread_mutex_unlock(&coordinator.lock);
+
+        printf("%s── Shard %d%s %s(pid %d, %d tunnels)%s%s\n", C_GREY, s, C_RESET, C_DIM, pid, tunnels, C_RESET,
+               rc == 0 ? "" : C_RED " unreachable" C_RESET);
+        char *save = NULL;
+        for (char *line = rc == 0 ? strtok_r(reply, "\n", &save) : NULL; line; line = strtok_r(NULL, "\n", &save))
+        {
+            char name[MAX_NAME_LEN];
+            int status, restarts;
+            long age;
+            double rtt;
+            if (sscanf(line, "%63[^\t]\t%d\t%d\t%ld\t%lf", name, &status, &restarts, &age, &rtt) != 5 ||
+                status < 0 || status > TUNNEL_RECONNECTING)
+                continue;
+            total++;
+            running += status == TUNNEL_RUNNING;
+            printf("   %-20s %s%-12s%s Restarts: %s%d%s", name, colors[status],
+                   tm_status_name((tunnel_status_t)status), C_RESET, C_CYAN, restarts, C_RESET);
+            if (age >= 0)
+                printf(" | Last: %s%lds ago%s", C_DIM, age, C_RESET);
+            if (rtt >= 0 && status == TUNNEL_RUNNING)
+                printf(" | Probe: %s%.1fms%s", C_DIM, rtt, C_RESET);
+            printf("\n");
+        }
+        free(reply);
+    }
+    printf("%sRunning: %d / %d%s\n\n", C_BOLD, running, total, C_RESET);
+}
+
+// Coordinator: metrics of all shards; HELP/TYPE headers only from the first shard
+void coordinator_print_metrics(void)
+{
+    for (int s = 0; s < coordinator.count; s++)
+    {
+        char *reply = NULL;
+        size_t len = 0;
+        FILE *mem = open_memstream(&reply, &len);
+        shard_request(s, "metrics", mem);
+        fclose(mem);
+
+        // Label every sample with its shard so per-shard series (classes, ops) stay distinct
+        char *save = NULL;
+        for (char *line = strtok_r(reply, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+        {
+            size_t name_len = strcspn(line, "{ ");
+            if (line[0] == '#')
             {
-                printf("%s✅ Config file '%s' exists and is readable%s\n", C_SUCCESS, CONFIG_FILE, C_RESET);
+                if (s == 0)
+                    printf("%s\n", line);
             }
+            else if (line[name_len] == '{')
+                printf("%.*s{shard=\"%d\",%s\n", (int)name_len, line, s, line + name_len + 1);
             else
-            {
-                printf("%s❌ Config file '%s' is not accessible: %s%s\n", C_ERROR, CONFIG_FILE, strerror(errno), C_RESET);
-            }
+                printf("%.*s{shard=\"%d\"}%s\n", (int)name_len, line, s, line + name_len);
+        }
+        free(reply);
+    }
+    pthread_mutex_lock(&coordinator.lock);
+    printf("# HELP tunnel_shard_restarts_total Shard process respawns\n# TYPE tunnel_shard_restarts_total counter\n");
+    for (int s = 0; s < coordinator.count; s++)
+        printf("tunnel_shard_restarts_total{shard=\"%d\"} %d\n", s, coordinator.shards[s].restarts);
+    pthread_mutex_unlock(&coordinator.lock);
+}
 
-            // Count tunnel types
-            int reverse_count = 0, forward_count = 0;
-            pthread_mutex_lock(&manager.mutex);
-            for (int i = 0; i < manager.count; i++)
-            {
-                if (manager.tunnels[i].type == TUNNEL_TYPE_REVERSE)
-                    reverse_count++;
-                else
-                    forward_count++;
-            }
-            pthread_mutex_unlock(&manager.mutex);
+// Coordinator: route a command to the owning shard, or to all shards without a name
+void coordinator_route(const char *cmd, const char *name)
+{
+    if (name && *name)
+    {
+        int s = shard_of(name);
+        if (s < 0)
+            printf("%s❌ Tunnel '%s' not found%s\n", C_ERROR, name, C_RESET);
+        else if (shard_request(s, cmd, stdout) != 0)
+            printf("%s❌ Shard %d unreachable%s\n", C_ERROR, s, C_RESET);
+        return;
+    }
+    for (int s = 0; s < coordinator.count; s++)
+    {
+        if (shard_request(s, cmd, stdout) != 0)
+            printf("%s❌ Shard %d unreachable%s\n", C_ERROR, s, C_RESET);
+    }
+}
 
-            printf("\n%sTunnel Type Distribution:%s\n", C_BOLD, C_RESET);
-            printf("  %sForward tunnels (-L):%s %d\n", C_GREEN, C_RESET, forward_count);
-            printf("  %sReverse tunnels (-R):%s %d\n", C_MAGENTA, C_RESET, reverse_count);
+// Run as coordinator for 'count' shards. Returns the process exit code.
+int run_coordinator(const char *config_file, int count)
+{
+    coordinator.count = count;
+    coordinator.config_file = config_file;
+#ifdef __APPLE__
+    uint32_t size = sizeof(coordinator.exe);
+    ssize_t n = _NSGetExecutablePath(coordinator.exe, &size) == 0 ? (ssize_t)strlen(coordinator.exe) : -1;
+#else
+    ssize_t n = readlink("/proc/self/exe", coordinator.exe, sizeof(coordinator.exe) - 1);
+    if (n > 0)
+        coordinator.exe[n] = 0;
+#endif
+    if (n <= 0)
+    {
+        fprintf(stderr, "%s❌ Cannot resolve own executable for shard processes%s\n", C_ERROR, C_RESET);
+        return 1;
+    }
 
-            if (reverse_count > 0)
-            {
-                printf("\n%s⚠️  Reverse Tunnel Requirements:%s\n", C_WARNING, C_RESET);
-                printf("  • Remote server must have '%sGatewayPorts yes%s' in /etc/ssh/sshd_config\n", C_YELLOW, C_RESET);
-                printf("  • Remote ports must be available (not in use)\n");
-                printf("  • Firewall must allow the remote ports\n");
-                printf("  • Use '%ssudo systemctl reload sshd%s' after config changes\n", C_YELLOW, C_RESET);
-            }
+    struct stat st;
+    if (stat(config_file, &st) != 0 || shard_plan_load() != 0)
+    {
+        fprintf(stderr, "%s❌ Failed to load configuration%s\n", C_ERROR, C_RESET);
+        return 1;
+    }
+    coordinator.config_mtime = st.st_mtime;
 
-            // Check all SSH keys
-            printf("\n%sTunnel SSH Key Status:%s\n", C_BOLD, C_RESET);
-            pthread_mutex_lock(&manager.mutex);
-            for (int i = 0; i < manager.count; i++)
-            {
-                tunnel_t *tunnel = &manager.tunnels[i];
-                struct stat key_stat;
+    pthread_mutex_lock(&coordinator.lock);
+    for (int s = 0; s < count; s++)
+    {
+        printf("%s🧩 Starting shard %d (%d tunnels)%s\n", C_INFO, s, coordinator.shards[s].tunnels, C_RESET);
+        shard_spawn(s);
+    }
+    pthread_mutex_unlock(&coordinator.lock);
+
+    if (pthread_create(&coordinator.monitor, NULL, coordinator_monitor, NULL) != 0)
+        coordinator.monitor = 0;
+    sleep(1); // Let shards bind their sockets
+
+    char input[512];
+    printf("%s=== Sharded Command Mode ===%s\n", C_BOLD, C_RESET);
+    printf("Commands: %sstatus%s, %sshards%s, %sstart%s [name], %sstop%s [name], %sreset%s [name], %sops%s, %sedit%s <name> k=v, %smetrics%s, %squit%s\n\n",
+           C_CYAN, C_RESET, C_CYAN, C_RESET, C_GREEN, C_RESET, C_RED, C_RESET, C_MAGENTA, C_RESET,
+           C_MAGENTA, C_RESET, C_BLUE, C_RESET, C_CYAN, C_RESET, C_MAGENTA, C_RESET);
+    while (running)
+    {
+        printf("%stunnel%s> ", C_BOLD, C_RESET);
+        fflush(stdout);
+        if (!fgets(input, sizeof(input), stdin))
+            break;
+        input[strcspn(input, "\n")] = 0;
 
-                printf("  %s%s%s [%s]: ", C_CYAN, tunnel->name, C_RESET,
-                       tunnel->type == TUNNEL_TYPE_REVERSE ? "REVERSE" : "FORWARD");
-                if (stat(tunnel->ssh_key, &key_stat) == 0)
-                {
-                    int perms = key_stat.st_mode & 0777;
-                    if (perms <= 0600)
-                    {
-                        printf("%s✅ Key exists, permissions OK (%o)%s\n", C_SUCCESS, perms, C_RESET);
-                    }
-                    else
-                    {
-                        printf("%s⚠️  Key exists but permissions too open (%o, should be 600)%s\n", C_WARNING, perms, C_RESET);
-                    }
-                }
-                else
-                {
-                    printf("%s❌ Key not found: %s%s\n", C_ERROR, tunnel->ssh_key, C_RESET);
-                }
-            }
-            pthread_mutex_unlock(&manager.mutex);
-            printf("\n");
+        char *arg = strchr(input, ' ');
+        if (arg)
+        {
+            *arg++ = 0;
+            while (*arg == ' ')
+                arg++;
         }
-        else if (strcmp(input, "watch") == 0)
+        char cmd[600];
+        snprintf(cmd, sizeof(cmd), "%s%s%s", input, arg ? " " : "", arg ? arg : "");
+
+        if (strcmp(input, "status") == 0 || strcmp(input, "") == 0)
         {
-            printf("%s🔄 Entering watch mode (press Ctrl+C to exit)...%s\n\n", C_INFO, C_RESET);
-            while (manager.running)
+            coordinator_print_status();
+        }
+        else if (strcmp(input, "shards") == 0)
+        {
+            pthread_mutex_lock(&coordinator.lock);
+            for (int s = 0; s < coordinator.count; s++)
             {
-                print_status();
-                printf("%sRefreshing in 2 seconds... (Ctrl+C to exit watch mode)%s\n", C_DIM, C_RESET);
-                sleep(2);
+                shard_t *shard = &coordinator.shards[s];
+                printf("  Shard %-3d pid %-7d tunnels %-3d respawns %-3d up %lds\n", s, shard->pid,
+                       shard->tunnels, shard->restarts, shard->pid ? (long)(time(NULL) - shard->started) : 0L);
             }
+            pthread_mutex_unlock(&coordinator.lock);
+        }
+        else if (strcmp(input, "metrics") == 0)
+        {
+            coordinator_print_metrics();
+        }
+        else if (strcmp(input, "ops") == 0)
+        {
+            coordinator_route("ops", NULL);
+        }
+        else if (strcmp(input, "stats") == 0)
+        {
+            coordinator_route("stats", NULL); // One report per shard process
+        }
+        else if (strcmp(input, "start") == 0 || strcmp(input, "stop") == 0 || strcmp(input, "reset") == 0)
+        {
+            coordinator_route(cmd, arg);
+        }
+        else if (strcmp(input, "edit") == 0 && arg)
+        {
+            char name[MAX_NAME_LEN];
+            snprintf(name, sizeof(name), "%.*s", (int)strcspn(arg, " "), arg);
+            coordinator_route(cmd, name);
         }
         else if (strcmp(input, "quit") == 0 || strcmp(input, "exit") == 0)
         {
@@ -1407,84 +1690,281 @@ void interactive_mode(void)
         }
         else if (strcmp(input, "help") == 0)
         {
-            printf("\n%s📋 Available Commands:%s\n", C_BOLD, C_RESET);
-            printf("  %sstatus%s       - Show tunnel status (default)\n", C_CYAN, C_RESET);
-            printf("  %sstart%s        - Start all tunnels\n", C_GREEN, C_RESET);
-            printf("  %sstart <name>%s - Start specific tunnel\n", C_GREEN, C_RESET);
-            printf("  %sstop%s         - Stop all tunnels\n", C_RED, C_RESET);
-            printf("  %sstop <name>%s  - Stop specific tunnel\n", C_RED, C_RESET);
-            printf("  %sreset <name>%s - Restart specific tunnel\n", C_MAGENTA, C_RESET);
-            printf("  %sadd%s          - Add new tunnel interactively\n", C_BLUE, C_RESET);
-            printf("  %stest%s         - Test all tunnel connectivity\n", C_YELLOW, C_RESET);
-            printf("  %stest <name>%s  - Test specific tunnel connectivity\n", C_YELLOW, C_RESET);
-            printf("  %sdebug%s        - Show SSH commands for all tunnels\n", C_RED, C_RESET);
-            printf("  %sdebug <name>%s - Show SSH command for specific tunnel\n", C_RED, C_RESET);
-            printf("  %sdiagnose%s     - Run system diagnostics\n", C_CYAN, C_RESET);
-            printf("  %swatch%s        - Live status updates (refresh every 2s)\n", C_YELLOW, C_RESET);
-            printf("  %squit%s         - Exit program\n", C_MAGENTA, C_RESET);
-            printf("  %shelp%s         - Show this help\n\n", C_BLUE, C_RESET);
-            printf("%s💡 Examples:%s\n", C_BOLD, C_RESET);
-            printf("  start db-prod   %s# Start specific tunnel%s\n", C_DIM, C_RESET);
-            printf("  stop web-dev    %s# Stop specific tunnel%s\n", C_DIM, C_RESET);
-            printf("  test db-prod    %s# Test if tunnel is really working%s\n", C_DIM, C_RESET);
-            printf("  diagnose        %s# Check system health and SSH keys%s\n", C_DIM, C_RESET);
-            printf("  reset api-test  %s# Restart tunnel with reset counter%s\n\n", C_DIM, C_RESET);
-
-            printf("%s🔄 Tunnel Types:%s\n", C_BOLD, C_RESET);
-            printf("  %sForward (-L):%s Remote service → Local access\n", C_GREEN, C_RESET);
-            printf("  %sReverse (-R):%s Local service → Remote access\n", C_MAGENTA, C_RESET);
-            printf("  %sExample:%s ssh -R 6983:127.0.0.1:2283 user@server\n", C_DIM, C_RESET);
-            printf("           %s# Opens port 6983 on server, forwards to local 2283%s\n\n", C_DIM, C_RESET);
+            printf("  status, shards, start|stop|reset [name], ops, stats, edit <name> k=v, metrics, quit\n");
+            printf("  %sOther commands are only available without --shards%s\n\n", C_DIM, C_RESET);
         }
-        else if (strlen(input) > 0)
+        else
         {
             printf("%s❌ Unknown command: %s%s%s (type '%shelp%s' for commands)%s\n\n",
                    C_ERROR, C_BOLD, input, C_RESET, C_BLUE, C_RESET, C_RESET);
         }
     }
+
+    running = 0;
+    if (coordinator.monitor)
+        pthread_join(coordinator.monitor, NULL);
+    pthread_mutex_lock(&coordinator.lock);
+    for (int s = 0; s < coordinator.count; s++)
+        shard_terminate(s);
+    pthread_mutex_unlock(&coordinator.lock);
+    return 0;
 }
 
-void signal_handler(int sig)
+// ─── HA lease ───────────────────────────────────────────────────────────────
+// Two instances started with the same --ha lease file form an active/passive pair.
+// The active one holds an fcntl write lock on the file and writes a heartbeat line
+// every third of the lease interval. The standby keeps config, keys and DNS warm,
+// polls the lock and takes over as soon as the kernel releases it (active died).
+// An active whose heartbeat is older than the lease interval is considered hung
+// and fenced with SIGKILL, so takeover stays within one lease interval. Both
+// instances run on one host, so heartbeats use CLOCK_BOOTTIME: wall clock steps
+// (NTP, manual date changes) can neither fake nor hide a missed heartbeat.
+
+typedef struct
 {
-    printf("\n%s🛑 Received signal %d, shutting down gracefully...%s\n", C_WARNING, sig, C_RESET);
-    manager.running = 0;
+    int fd;
+    int lease_ms;
+    int active;
+    double detect_ms;   // Last heartbeat of the old active -> lease acquired
+    double takeover_ms; // Detection plus time until all tunnels RUNNING, 0 = no takeover
+    pthread_t thread;
+} ha_state_t;
+
+static ha_state_t ha = {.fd = -1, .lease_ms = 3000};
+
+long long lease_clock_ms(void)
+{
+    struct timespec ts;
+#ifdef CLOCK_BOOTTIME
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts); // Darwin: also host-wide and immune to clock steps
+#endif
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int ha_try_lock(void)
+{
+    struct flock fl = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+    return fcntl(ha.fd, F_SETLK, &fl) == 0;
+}
+
+// PID of the process holding the lease lock, 0 if none (or not visible from here)
+pid_t ha_lock_holder(void)
+{
+    struct flock fl = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+    if (fcntl(ha.fd, F_GETLK, &fl) != 0 || fl.l_type == F_UNLCK)
+        return 0;
+    return fl.l_pid;
 }
 
-void cleanup_manager(void)
+// Heartbeat line: "<pid> <seq> <CLOCK_BOOTTIME ms> <lease ms>"
+void ha_write_heartbeat(unsigned long seq)
 {
-    stop_all_tunnels();
+    char line[96];
+    int len = snprintf(line, sizeof(line), "%d %lu %lld %d\n", getpid(), seq, lease_clock_ms(), ha.lease_ms);
+    if (pwrite(ha.fd, line, len, 0) == len)
+        ftruncate(ha.fd, len);
+}
+
+int ha_read_heartbeat(pid_t *pid, long long *at_ms)
+{
+    char line[96] = {0};
+    if (pread(ha.fd, line, sizeof(line) - 1, 0) <= 0)
+        return -1;
+    unsigned long seq;
+    int lease;
+    return sscanf(line, "%d %lu %lld %d", pid, &seq, at_ms, &lease) == 4 ? 0 : -1;
+}
+
+void *ha_heartbeat_worker(void *arg)
+{
+    (void)arg;
+    pthread_setname_np(pthread_self(), "tm-ha");
+    unsigned long seq = 0;
+    while (running)
+    {
+        ha_write_heartbeat(++seq);
+        usleep(ha.lease_ms * 1000 / 3);
+    }
+    return NULL;
+}
+
+// Standby warm-up: resolve every host (fills resolver caches) and read every key
+// so takeover doesn't wait on DNS or a cold disk
+void ha_warm(void)
+{
+    tm_tunnel_info_t tunnels[MAX_TUNNELS];
+    int count = tm_snapshot(engine, tunnels, MAX_TUNNELS);
+    for (int i = 0; i < count; i++)
+    {
+        struct addrinfo hints = {.ai_socktype = SOCK_STREAM}, *res = NULL;
+        if (getaddrinfo(tunnels[i].host, NULL, &hints, &res) == 0)
+            freeaddrinfo(res);
+        free(tm_read_file(tunnels[i].ssh_key));
+    }
+}
+
+// Become the active instance, waiting as standby while another instance holds
+// the lease. Returns -1 if shut down while standing by.
+int ha_acquire_lease(const char *path)
+{
+    ha.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (ha.fd < 0)
+    {
+        fprintf(stderr, "%s❌ Cannot open lease file '%s': %s%s\n", C_ERROR, path, strerror(errno), C_RESET);
+        return -1;
+    }
 
-    // Close log files
-    for (int i = 0; i < manager.count; i++)
+    if (!ha_try_lock())
     {
-        if (manager.tunnels[i].log)
+        pid_t active = 0;
+        long long beat = 0, last_warm = 0;
+        ha_read_heartbeat(&active, &beat);
+        printf("%s🛡️  HA standby: lease '%s' held by pid %d, keeping config, keys and DNS warm%s\n",
+               C_INFO, path, active, C_RESET);
+
+        while (running && !ha_try_lock())
         {
-            fclose(manager.tunnels[i].log);
-            manager.tunnels[i].log = NULL;
+            long long now = lease_clock_ms();
+            if (now - last_warm >= ha.lease_ms)
+            {
+                ha_warm();
+                last_warm = now;
+            }
+            // Fence only the lock holder itself: a stale heartbeat pid may
+            // meanwhile belong to an unrelated process
+            if (ha_read_heartbeat(&active, &beat) == 0 && now - beat > ha.lease_ms &&
+                active > 0 && active != getpid() && ha_lock_holder() == active)
+            {
+                printf("%s🔪 Active pid %d missed its lease (%lld ms since heartbeat), fencing%s\n",
+                       C_WARNING, active, now - beat, C_RESET);
+                kill(active, SIGKILL);
+            }
+            usleep(50000);
         }
+        if (!running)
+            return -1;
+
+        ha.detect_ms = beat > 0 ? (double)(lease_clock_ms() - beat) : 0;
+        printf("%s⚡ HA takeover: lease acquired %.0f ms after the last heartbeat of pid %d%s\n",
+               C_WARNING, ha.detect_ms, active, C_RESET);
+    }
+    else
+    {
+        printf("%s🛡️  HA active: holding lease '%s' (interval %d ms)%s\n", C_SUCCESS, path, ha.lease_ms, C_RESET);
+    }
+
+    ha.active = 1;
+    ha_write_heartbeat(0);
+    if (pthread_create(&ha.thread, NULL, ha_heartbeat_worker, NULL) != 0)
+        ha.thread = 0;
+    return 0;
+}
+
+// After a takeover: measure until every started tunnel is RUNNING again
+void ha_report_takeover(void)
+{
+    wait_result_t result;
+    int ok = tm_wait(engine, "*", 0, 60000, &result) == 0;
+    ha.takeover_ms = ha.detect_ms + result.waited_ms;
+    printf("%s%s HA takeover %s: %.0f ms total (detect %.0f ms + tunnels %.0f ms, %s)%s\n",
+           ok ? C_SUCCESS : C_WARNING, ok ? "✅" : "⚠️ ", ok ? "complete" : "incomplete",
+           ha.takeover_ms, ha.detect_ms, result.waited_ms, result.detail, C_RESET);
+}
+
+// Engine metrics plus the HA gauges of this process
+void print_metrics(FILE *out)
+{
+    tm_write_metrics(engine, out);
+    if (ha.fd >= 0)
+    {
+        fprintf(out, "# HELP tunnel_ha_active This instance holds the HA lease\n# TYPE tunnel_ha_active gauge\n");
+        fprintf(out, "tunnel_ha_active %d\n", ha.active);
+        fprintf(out, "# HELP tunnel_ha_takeover_seconds Last takeover: lease detection plus tunnels RUNNING\n# TYPE tunnel_ha_takeover_seconds gauge\n");
+        fprintf(out, "tunnel_ha_takeover_seconds %.3f\n", ha.takeover_ms / 1000.0);
+    }
+}
+
+void ha_release(void)
+{
+    running = 0;
+    if (ha.thread)
+    {
+        pthread_join(ha.thread, NULL);
+        ha.thread = 0;
     }
+    if (ha.fd >= 0)
+    {
+        close(ha.fd); // Releases the lease for the standby
+        ha.fd = -1;
+    }
+}
 
-    pthread_mutex_destroy(&manager.mutex);
+void signal_handler(int sig)
+{
+    printf("\n%s🛑 Received signal %d, shutting down gracefully...%s\n", C_WARNING, sig, C_RESET);
+    running = 0;
 }
 
 int main(int argc, char **argv)
 {
-    const char *config_file = (argc > 1) ? argv[1] : CONFIG_FILE;
+    int shards = 0;
+    const char *ha_file = NULL;
+    const char *http_listen = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+        {
+            shards = tm_parse_int(argv[++i], 1, MAX_SHARDS);
+            if (shards < 1)
+            {
+                fprintf(stderr, "Error: --shards expects 1-%d\n", MAX_SHARDS);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--ha") == 0 && i + 1 < argc)
+        {
+            ha_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--http") == 0 && i + 1 < argc)
+        {
+            http_listen = argv[++i]; // [addr:]port of the web dashboard
+        }
+        else if (strcmp(argv[i], "--lease") == 0 && i + 1 < argc)
+        {
+            ha.lease_ms = tm_parse_int(argv[++i], 200, 600000);
+            if (ha.lease_ms < 0)
+            {
+                fprintf(stderr, "Error: --lease expects 200-600000 ms\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc)
+        {
+            // Internal: started by the coordinator as shard i of n
+            if (sscanf(argv[++i], "%d/%d", &shard_index, &shard_count) != 2 ||
+                shard_count < 1 || shard_index < 0 || shard_index >= shard_count)
+            {
+                fprintf(stderr, "Error: invalid --shard '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+        {
+            config_path = argv[i];
+        }
+    }
 
     // Startup Banner
-    printf("%s╔══════════════════════════════════════════════════════════════════════════╗%s\n", C_CYAN, C_RESET);
-    printf("%s║%s %sChief Tunnel Officer - SSH Tunnel Manager v1.0%s %s║%s\n",
-           C_CYAN, C_RESET, C_BOLD, C_RESET, C_CYAN, C_RESET);
-    printf("%s║%s %sThe ultimate SSH tunnel daemon for real engineers%s %s║%s\n",
-           C_CYAN, C_RESET, C_DIM, C_RESET, C_CYAN, C_RESET);
-    printf("%s╚══════════════════════════════════════════════════════════════════════════╝%s\n\n", C_CYAN, C_RESET);
-
-    // Initialize
-    manager.running = 1;
-    if (pthread_mutex_init(&manager.mutex, NULL) != 0)
+    if (shard_count == 0)
     {
-        fprintf(stderr, "%s❌ Error: Failed to initialize mutex%s\n", C_ERROR, C_RESET);
-        return 1;
+        printf("%s╔══════════════════════════════════════════════════════════════════════════╗%s\n", C_CYAN, C_RESET);
+        printf("%s║%s %sChief Tunnel Officer - SSH Tunnel Manager v1.0%s %s║%s\n",
+               C_CYAN, C_RESET, C_BOLD, C_RESET, C_CYAN, C_RESET);
+        printf("%s║%s %sThe ultimate SSH tunnel daemon for real engineers%s %s║%s\n",
+               C_CYAN, C_RESET, C_DIM, C_RESET, C_CYAN, C_RESET);
+        printf("%s╚══════════════════════════════════════════════════════════════════════════╝%s\n\n", C_CYAN, C_RESET);
     }
 
     // Create logs directory
@@ -1492,41 +1972,96 @@ int main(int argc, char **argv)
     printf("%s📁 Logs directory: %s%s%s\n", C_INFO, C_BOLD, LOG_DIR, C_RESET);
 
     // Setup signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // No SA_RESTART: a blocked prompt read returns so SIGTERM shuts down (and frees the HA lease)
+    struct sigaction sa = {.sa_handler = signal_handler};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
     printf("%s⚡ Signal handlers registered%s\n", C_SUCCESS, C_RESET);
 
+    // A sharded coordinator takes the lease before spawning shards
+    if (shards > 0 && ha_file && ha_acquire_lease(ha_file) != 0)
+    {
+        ha_release();
+        return 1;
+    }
+    if (shards > 0)
+    {
+        printf("%s🧩 Sharded mode: %s%d%s worker processes%s\n", C_INFO, C_BOLD, shards, C_RESET, C_RESET);
+        int rc = run_coordinator(config_path, shards);
+        ha_release();
+        return rc;
+    }
+
     // Load configuration
-    printf("%s📋 Loading configuration from: %s%s%s\n", C_INFO, C_BOLD, config_file, C_RESET);
-    if (load_config(config_file) != 0)
+    printf("%s📋 Loading configuration from: %s%s%s\n", C_INFO, C_BOLD, config_path, C_RESET);
+    tm_options_t options = {.config_file = config_path, .on_event = print_event};
+    if (shard_count > 0)
+        options.filter = shard_filter;
+    char error[256] = "";
+    engine = tm_open(&options, error, sizeof(error));
+    if (!engine)
     {
-        fprintf(stderr, "%s❌ Failed to load configuration%s\n", C_ERROR, C_RESET);
-        cleanup_manager();
+        fprintf(stderr, "%s❌ Failed to load configuration: %s%s\n", C_ERROR, error, C_RESET);
         return 1;
     }
 
-    if (manager.count == 0)
+    int count = tm_count(engine);
+    if (shard_count > 0)
+    {
+        printf("%s🧩 Shard %d/%d (pid %d): %d tunnels%s\n", C_INFO, shard_index, shard_count,
+               getpid(), count, C_RESET);
+    }
+    else if (count == 0)
     {
         printf("%s⚠️  No tunnels configured, exiting.%s\n", C_WARNING, C_RESET);
-        cleanup_manager();
+        tm_close(engine);
         return 1;
     }
 
     printf("%s✅ Loaded %s%d%s tunnels successfully%s\n\n",
-           C_SUCCESS, C_BOLD, manager.count, C_RESET, C_RESET);
+           C_SUCCESS, C_BOLD, count, C_RESET, C_RESET);
+
+    // HA pair: stand by (config parsed, keys and DNS warm) until we hold the lease
+    if (ha_file && ha_acquire_lease(ha_file) != 0)
+    {
+        int rc = running ? 1 : 0;
+        tm_close(engine);
+        ha_release();
+        return rc;
+    }
 
     // Start tunnels
     printf("%s🚀 Auto-starting all tunnels...%s\n", C_INFO, C_RESET);
-    start_all_tunnels();
+    if (tm_run(engine, error, sizeof(error)) != 0)
+    {
+        fprintf(stderr, "%s❌ %s%s\n", C_ERROR, error, C_RESET);
+        tm_close(engine);
+        ha_release();
+        return 1;
+    }
+    if (http_listen && shard_count == 0 && dashboard_start(engine, http_listen) != 0)
+    {
+        tm_close(engine);
+        ha_release();
+        return 1;
+    }
     sleep(1); // Brief pause für startup
+    if (ha.detect_ms > 0)
+        ha_report_takeover();
 
-    // Enter interactive mode
-    interactive_mode();
+    // Enter interactive mode, or serve the coordinator when running as a shard
+    if (shard_count > 0)
+        shard_serve();
+    else
+        interactive_mode();
 
     // Cleanup
     printf("\n%s🛑 Initiating shutdown sequence...%s\n", C_WARNING, C_RESET);
-    manager.running = 0;
-    cleanup_manager();
+    running = 0;
+    dashboard_stop();
+    tm_close(engine);
+    ha_release();
 
     printf("%s👋 Chief Tunnel Officer signing off. All tunnels terminated.%s\n", C_SUCCESS, C_RESET);
     printf("%s══════════════════════════════════════════════════════════════════════════%s\n", C_GREY, C_RESET);
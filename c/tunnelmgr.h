@@ -0,0 +1,287 @@
+#ifndef TUNNELMGR_H
+#define TUNNELMGR_H
+
+// libtunnelmgr - embeddable SSH tunnel engine of the Chief Tunnel Officer.
+//
+// The engine supervises ssh processes for the tunnels of one config file:
+// reconnects with backoff, health probes, schedule windows and asynchronous
+// start/stop/reset operations. tunnel_manager (main.c) is one client of it.
+//
+// Threading: all control and snapshot calls are thread-safe. Event callbacks
+// run on engine threads, sometimes with the engine lock held, so they must be
+// quick and must not call back into tm_* functions.
+//
+// One engine per process: tm_open() fails while another handle is open.
+//
+// The library writes nothing to stdout/stderr. Engine-wide messages (config
+// warnings, a thread that could not be started, ...) arrive as TM_EVENT_LOG
+// with tunnel "" at the level of the "stderr" events sink; errors that make a
+// call fail are returned in its msg buffer. Only tm_* symbols are exported.
+
+#include <stdio.h>
+#include <time.h>
+
+#define MAX_TUNNELS 32
+#define LOG_DIR "logs"
+#define CONFIG_FILE "config.json"
+#define MAX_CMD_LEN 512
+#define MAX_NAME_LEN 64
+#define MAX_HOST_LEN 128
+#define MAX_PATH_LEN 256
+#define MAX_OPS 256 // Control operation history (ring buffer)
+#define MAX_TAGS 8
+#define MAX_NAMESPACES 8 // Including the default namespace of the main config
+
+typedef enum
+{
+    TUNNEL_STOPPED = 0,
+    TUNNEL_STARTING,
+    TUNNEL_RUNNING,
+    TUNNEL_ERROR,
+    TUNNEL_AUTH_ERROR, // SSH key/authentication problems
+    TUNNEL_PORT_ERROR, // Port already in use
+    TUNNEL_RECONNECTING
+} tunnel_status_t;
+
+typedef enum
+{
+    TUNNEL_TYPE_FORWARD = 0, // -L (default) - Remote service accessible locally
+    TUNNEL_TYPE_REVERSE = 1  // -R - Local service accessible remotely
+} tunnel_type_t;
+
+typedef enum
+{
+    OP_START = 0,
+    OP_STOP,
+    OP_RESET
+} op_type_t;
+
+typedef enum
+{
+    OP_PENDING = 0,  // Queued, not yet picked up by the control thread
+    OP_IN_PROGRESS,  // Waiting for the worker thread to exit
+    OP_DONE,
+    OP_FAILED
+} op_state_t;
+
+typedef struct
+{
+    int id;
+    op_type_t type;
+    op_state_t state;
+    char tunnel[MAX_NAME_LEN];
+    struct timespec submitted; // CLOCK_MONOTONIC
+    double latency_ms;         // Submit -> completion
+    char result[128];
+} control_op_t;
+
+typedef struct
+{
+    int ok;           // All matched tunnels became ready
+    int matched;      // Tunnels selected by name or tag
+    double waited_ms; // Measured wait
+    char detail[256]; // Failure reason or summary
+} wait_result_t;
+
+// Point-in-time copy of one tunnel, see tm_snapshot()
+typedef struct
+{
+    // Configuration
+    char name[MAX_NAME_LEN]; // "<namespace>/<name>" outside the default namespace
+    char ns[MAX_NAME_LEN];   // Namespace, "" = default (main config)
+    char group[MAX_NAME_LEN]; // Fan-out: reverse tunnel this is one exposure of ("<name>@<host>"), "" = none
+    int group_up;             // Fan-out: exposures RUNNING ...
+    int group_size;           // ... of all of them
+    char host[MAX_HOST_LEN];
+    int port;
+    char user[MAX_NAME_LEN];
+    char ssh_key[MAX_PATH_LEN];
+    tunnel_type_t type;
+    int local_port;
+    char remote_host[MAX_HOST_LEN];
+    int remote_port; // Reverse: 0 = allocated by the server ("auto")
+    int reconnect_delay;
+    char tags[MAX_TAGS][MAX_NAME_LEN];
+    int tag_count;
+    char priority[16]; // Priority class name
+    char schedule[MAX_NAME_LEN];
+    int window; // Seconds, 0 = not scheduled
+    int max_session_age; // Seconds, 0 = sessions are not recycled
+    int recycle_when_idle;
+    char remediate[16]; // "none", "recycle" or "failover"
+    char alternate_host[MAX_HOST_LEN];
+    int reclaim_listener; // Reverse: clean up stale remote listeners
+    int client_alive;     // Reverse: server keepalive timeout in seconds, 0 = unknown
+    int config_version;
+
+    // Runtime state
+    tunnel_status_t status;
+    int restart_count;
+    time_t last_restart;
+    int should_run;
+    time_t last_probe;   // 0 = not probed yet
+    double probe_rtt_ms; // Round trip through the tunnel, -1 = no sample
+    int standby;         // Warm standby master session is up
+    time_t next_window;  // Start of the current or next window
+    time_t window_end;   // End of the current window, 0 outside
+    int prewarm_lead;    // Seconds a window is opened early
+    double ready_ms;     // Smoothed time from connection attempt to RUNNING
+    time_t session_start; // Current ssh session RUNNING since, 0 = none
+    int session_recycles; // Recycles by the session age policy
+    int recycle_impact;   // Connections open when those recycles happened
+    double rtt_baseline_ms;       // EWMA of the probe RTT, -1 = no samples yet
+    int degraded;                 // Probe latency significantly above the baseline
+    int remediations;
+    int remediations_helped;      // Latency at least halved afterwards
+    double remediation_before_ms; // Last remediation, -1 = none
+    double remediation_after_ms;  // -1 = none or still measuring
+    int listener_reclaims;        // Stale remote listeners cleaned up
+    int allocated_port;           // Remote port in use (auto: as allocated), 0 = not known yet
+    int port_parked;              // PORT_ERROR: waiting for local_port to become free
+    long channel_failures;        // ssh could not open a connection to the backend
+    int channel_rate;             // ... per minute
+    int backend_failing;          // channel_rate at or above the warning threshold
+    char last_ssh_output[160];    // Most recent ssh output line
+} tm_tunnel_info_t;
+
+typedef enum
+{
+    TM_LOG_DEBUG = 0, // SSH output and commands
+    TM_LOG_INFO,
+    TM_LOG_WARN,
+    TM_LOG_ERROR,
+    TM_LOG_OFF // Sink level only: write nothing
+} tm_log_level_t;
+
+typedef enum
+{
+    TM_EVENT_LOG = 0, // A line was written to the tunnel's log
+    TM_EVENT_STATE    // The tunnel's status changed
+} tm_event_type_t;
+
+typedef struct
+{
+    tm_event_type_t type;
+    const char *tunnel;         // "" for engine-wide messages
+    time_t when;
+    const char *message;        // TM_EVENT_LOG
+    tunnel_status_t old_status; // TM_EVENT_STATE
+    tunnel_status_t status;
+    tm_log_level_t level;       // TM_EVENT_LOG
+    int suppressed;             // TM_EVENT_LOG: events sampled out before this one
+} tm_event_t;
+
+typedef void (*tm_event_cb)(const tm_event_t *event, void *user);
+
+typedef struct
+{
+    const char *config_file; // NULL = CONFIG_FILE
+    tm_event_cb on_event;    // Optional
+    void *user;              // Passed to on_event and filter
+
+    // Optional: load only the tunnels this returns non-zero for. Entries filtered
+    // out are carried over unchanged when the engine saves the config.
+    int (*filter)(const char *name, const char *host, void *user);
+} tm_options_t;
+
+typedef struct tm_manager tm_manager_t;
+
+// Lifecycle: open loads the config, run starts the engine threads and the
+// tunnels, close stops everything and frees the handle. On failure open returns
+// NULL and run -1, with the reason in msg.
+tm_manager_t *tm_open(const tm_options_t *options, char *msg, size_t msg_len);
+int tm_run(tm_manager_t *tm, char *msg, size_t msg_len);
+void tm_close(tm_manager_t *tm);
+
+// Snapshot reads
+int tm_count(tm_manager_t *tm);
+int tm_snapshot(tm_manager_t *tm, tm_tunnel_info_t *out, int max);
+int tm_get_tunnel(tm_manager_t *tm, const char *name, tm_tunnel_info_t *out);
+
+// Control. Start/stop/reset are queued and return the op id, -1 if the queue
+// is full; tm_get_op() reports progress. The name of a fan-out reverse tunnel
+// ("hosts" in the config) selects all of its exposures.
+int tm_start_tunnel(tm_manager_t *tm, const char *name);
+int tm_stop_tunnel(tm_manager_t *tm, const char *name);
+int tm_reset_tunnel(tm_manager_t *tm, const char *name);
+int tm_get_op(tm_manager_t *tm, int id, control_op_t *out);
+int tm_edit_tunnel(tm_manager_t *tm, const char *name, const char *assignments, char *msg, size_t msg_len);
+int tm_add_tunnel(tm_manager_t *tm, const tm_tunnel_info_t *spec, char *msg, size_t msg_len);
+int tm_wait(tm_manager_t *tm, const char *selector, int probe, int timeout_ms, wait_result_t *result);
+int tm_probe_port(int port);
+
+// Log sinks ("file", "stderr" = TM_EVENT_LOG callbacks, "journal" = journald
+// with structured fields, on by default under systemd): set the level
+// (debug, info, warn, error, off; NULL keeps it) and the per-tunnel sampling rate
+// in events per second (0 = unlimited, -1 keeps it). With a tunnel name only the
+// level of that tunnel changes ("default" returns it to the sink level).
+int tm_set_log_sink(tm_manager_t *tm, const char *sink, const char *tunnel, const char *level, int rate,
+                    char *msg, size_t msg_len);
+
+typedef enum
+{
+    TM_CHECK_OK = 0,
+    TM_CHECK_WARN,
+    TM_CHECK_FAIL,
+    TM_CHECK_TIMEOUT,
+    TM_CHECK_SKIPPED // An earlier check failed
+} tm_check_result_t;
+
+// One diagnose check result, see tm_diagnose()
+typedef struct
+{
+    char tunnel[MAX_NAME_LEN]; // "" for global checks (agent)
+    char check[16];            // key_file, key_parse, dns, tcp, banner, local_port, agent
+    tm_check_result_t result;
+    char detail[160];
+    double ms;                 // Time the check took
+    int age;                   // Seconds since it ran when served from the cache, -1 = just ran
+} tm_check_t;
+
+// Diagnose one tunnel (name) or all (NULL): key file and parse, DNS, TCP to the
+// ssh port, sshd banner, local port conflicts, plus the ssh-agent. Checks run in
+// parallel with a timeout each, results are cached briefly (fresh = bypass).
+// Returns the number of results written to out, -1 if the tunnel doesn't exist.
+int tm_diagnose(tm_manager_t *tm, const char *name, int fresh, tm_check_t *out, int max);
+
+// Last lines of a tunnel's log (events and ssh output), oldest first. Recent
+// history comes from memory; more lines than that are read from the log file.
+// Returns the number of lines written, -1 if the tunnel doesn't exist.
+int tm_logs(tm_manager_t *tm, const char *name, int lines, FILE *out);
+
+// Sleep about secs for refresh loops; in low-power mode aligned to the engine's
+// shared tick boundaries so the wakeup coincides with the engine's own
+void tm_tick_sleep(tm_manager_t *tm, int secs);
+
+// Reports
+void tm_write_metrics(tm_manager_t *tm, FILE *out);
+void tm_write_ops(tm_manager_t *tm, FILE *out);
+// Self-telemetry: manager CPU per thread role (since the previous call) versus
+// the ssh children, allocations and syscalls per subsystem
+void tm_write_stats(tm_manager_t *tm, FILE *out);
+
+// Namespaces: teams' tunnels with their own config file, log directory and
+// quotas in the same engine ("namespaces" in the main config). Tunnel names
+// outside the default namespace are "<namespace>/<name>".
+typedef struct
+{
+    char name[MAX_NAME_LEN]; // "" = default (main config)
+    char config_file[MAX_PATH_LEN];
+    char log_dir[MAX_PATH_LEN];
+    int max_tunnels;    // 0 = no quota
+    int max_connecting; // 0 = no quota
+} tm_namespace_info_t;
+
+int tm_namespaces(tm_manager_t *tm, tm_namespace_info_t *out, int max);
+// Per-namespace tunnels, handshakes and quota waits, plus the measured threads
+// and memory of this daemon
+void tm_write_namespaces(tm_manager_t *tm, FILE *out);
+
+// Helpers
+const char *tm_status_name(tunnel_status_t status);
+const char *tm_op_name(op_type_t type);
+int tm_parse_int(const char *value, int min, int max);
+char *tm_format_duration(long secs, char *buf, size_t len);
+char *tm_read_file(const char *filename);
+
+#endif